@@ -0,0 +1,488 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPair>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include "Comm.h"
+#include "DeviceData.h"
+#include "Device.h"
+#include "GangProgrammer.h"
+#include "ImportExportHex.h"
+#include "Programmer.h"
+#include "VerifyCompare.h"
+
+#include "../version.h"
+
+//Layout of the simulated part (see HIDAPI/sim/hid-sim.c).
+#define SIM_APP_START           0x1000
+#define SIM_DEFAULT_FLASH_SIZE  0x4000
+#define SIM_ERASE_PAGE_SIZE     64
+#define SIM_SIGNATURE_ADDRESS   0x1006
+
+//Nearest-rank percentile of an already sorted sample set.
+static qint64 Percentile(const QVector<qint64>& sorted, int percent)
+{
+    int rank;
+
+    if(sorted.isEmpty())
+    {
+        return 0;
+    }
+    rank = (sorted.count() * percent + 99) / 100;
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+    return sorted.at(rank - 1);
+}
+
+static QJsonObject TransferStats(QVector<qint64> samples, qint64 bytes, double seconds)
+{
+    QJsonObject object;
+    QJsonObject latency;
+
+    std::sort(samples.begin(), samples.end());
+    latency["p50"] = Percentile(samples, 50);
+    latency["p99"] = Percentile(samples, 99);
+    latency["max"] = samples.isEmpty() ? 0 : samples.last();
+
+    object["packets"] = samples.count();
+    object["bytes"] = bytes;
+    object["packetsPerSecond"] = (seconds > 0) ? samples.count() / seconds : 0;
+    object["bytesPerSecond"] = (seconds > 0) ? bytes / seconds : 0;
+    object["latencyUs"] = latency;
+    return object;
+}
+
+static double Seconds(QElapsedTimer& timer)
+{
+    return (double)timer.nsecsElapsed() / 1e9;
+}
+
+//Writes an Intel hex image of size bytes of pseudo random data starting at the
+//first application address.  The signature word is left blank, as a real
+//application image would, so the post SIGN_FLASH verify passes.
+static bool WriteSyntheticHex(QString fileName, uint32_t size)
+{
+    QFile file(fileName);
+    QTextStream stream(&file);
+    uint32_t seed = size;
+    uint32_t address = SIM_APP_START;
+    uint32_t end = SIM_APP_START + size;
+    uint32_t upper = 0xFFFFFFFF;
+    unsigned char record[16];
+    unsigned char checksum;
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        return false;
+    }
+
+    while(address < end)
+    {
+        if((address >> 16) != upper)
+        {
+            upper = address >> 16;
+            checksum = 0x02 + 0x04 + (upper >> 8) + (upper & 0xFF);
+            stream << QString(":02000004%1%2\n").arg(upper, 4, 16, QChar('0')).arg((unsigned char)-checksum, 2, 16, QChar('0')).toUpper();
+        }
+
+        unsigned int count = qMin((uint32_t)sizeof(record), end - address);
+        checksum = count + ((address >> 8) & 0xFF) + (address & 0xFF);
+        QString line = QString(":%1%200").arg(count, 2, 16, QChar('0')).arg(address & 0xFFFF, 4, 16, QChar('0'));
+        for(unsigned int i = 0; i < count; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            record[i] = (seed >> 16) & 0xFF;
+            if(((address + i) == SIM_SIGNATURE_ADDRESS) || ((address + i) == SIM_SIGNATURE_ADDRESS + 1))
+            {
+                record[i] = 0xFF;
+            }
+            checksum += record[i];
+            line += QString("%1").arg(record[i], 2, 16, QChar('0'));
+        }
+        line += QString("%1").arg((unsigned char)-checksum, 2, 16, QChar('0'));
+        stream << line.toUpper() << "\n";
+        address += count;
+    }
+    stream << ":00000001FF\n";
+
+    return true;
+}
+
+//Finds the highest program memory address used by a hex file, so the simulator can
+//be sized to hold it.
+static uint32_t HexEndAddress(QString fileName)
+{
+    QFile file(fileName);
+    uint32_t upper = 0;
+    uint32_t end = 0;
+
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        return 0;
+    }
+    while(!file.atEnd())
+    {
+        QByteArray line = file.readLine().trimmed();
+        if((line.size() < 11) || (line.at(0) != ':'))
+        {
+            continue;
+        }
+        unsigned int count = line.mid(1, 2).toUInt(NULL, 16);
+        unsigned int address = line.mid(3, 4).toUInt(NULL, 16);
+        unsigned int type = line.mid(7, 2).toUInt(NULL, 16);
+        if(type == HexImporter::EXTENDED_LINEAR_ADDR)
+        {
+            upper = line.mid(9, 4).toUInt(NULL, 16) << 16;
+        }
+        else if((type == HexImporter::DATA) && ((upper + address) < 0x300000))
+        {
+            end = qMax(end, upper + address + count);
+        }
+    }
+    return end;
+}
+
+//Runs import, erase, program, verify and sign for one image against a freshly
+//configured simulator and returns the measurements.
+static QJsonObject RunImage(QString name, QString fileName, int writeWindow, int readAheadWindow, bool* ok)
+{
+    QJsonObject run;
+    QJsonObject phases;
+    QElapsedTimer timer;
+    Comm comm;
+    Comm::BootInfo bootInfo;
+    Comm::ErrorCode result;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    HexImporter::ErrorCode importResult;
+    QVector<qint64> programSamples;
+    QVector<qint64> verifySamples;
+    qint64 programBytes = 0;
+    qint64 verifyBytes = 0;
+    double programTime, readTime, compareTime;
+    uint32_t flashSize;
+    int mismatches = 0;
+
+    *ok = false;
+    run["image"] = name;
+
+    //Size the simulated program memory to fit the image and start from a blank device.
+    flashSize = HexEndAddress(fileName);
+    flashSize = (flashSize + SIM_ERASE_PAGE_SIZE - 1) & ~(SIM_ERASE_PAGE_SIZE - 1);
+    flashSize = qMax(flashSize, (uint32_t)SIM_DEFAULT_FLASH_SIZE);
+    qputenv("HIDSIM_FLASH_SIZE", QByteArray::number(flashSize));
+    hid_exit();
+    hid_init();
+    run["flashSize"] = (qint64)flashSize;
+
+    QStringList paths = GangProgrammer::Enumerate();
+    if(paths.isEmpty() || (comm.open(paths.first().toLocal8Bit().constData()) != Comm::Success))
+    {
+        run["error"] = QString("no simulated device");
+        return run;
+    }
+    comm.setWriteWindow(writeWindow);
+    comm.setReadAheadWindow(readAheadWindow);
+
+    if(programmer.Query() != Comm::Success)
+    {
+        run["error"] = QString("query failed");
+        comm.close();
+        return run;
+    }
+
+    timer.start();
+    importResult = programmer.ImportHexFile(fileName, &hexData, import);
+    phases["import"] = Seconds(timer);
+    if(importResult != HexImporter::Success)
+    {
+        run["error"] = QString("import failed (%1)").arg(importResult);
+        comm.close();
+        Programmer::FreeRanges(&deviceData);
+        Programmer::FreeRanges(&hexData);
+        return run;
+    }
+
+    //Erase: the device only answers the following query once the erase is done.
+    timer.start();
+    result = comm.Erase();
+    if(result == Comm::Success)
+    {
+        result = comm.ReadBootloaderInfo(&bootInfo);
+    }
+    phases["erase"] = Seconds(timer);
+
+    comm.setLatencySamples(&programSamples);
+    timer.start();
+    foreach(DeviceData::MemoryRange range, hexData.ranges)
+    {
+        if((result != Comm::Success) || (range.type == CONFIG_MEMORY))
+        {
+            continue;
+        }
+        bool flash = (range.type == PROGRAM_MEMORY);
+        result = comm.Program(range.start, device.bytesPerPacket,
+                              flash ? device.bytesPerAddressFLASH : device.bytesPerAddressEEPROM,
+                              flash ? device.bytesPerWordFLASH : device.bytesPerWordEEPROM,
+                              device.family, range.end, range.pDataBuffer);
+        programBytes += range.dataBufferLength;
+    }
+    programTime = Seconds(timer);
+    phases["program"] = programTime;
+
+    comm.setLatencySamples(&verifySamples);
+    timer.start();
+    foreach(DeviceData::MemoryRange range, deviceData.ranges)
+    {
+        if((result != Comm::Success) || (range.type == CONFIG_MEMORY))
+        {
+            continue;
+        }
+        bool flash = (range.type == PROGRAM_MEMORY);
+        result = comm.GetData(range.start, device.bytesPerPacket,
+                              flash ? device.bytesPerAddressFLASH : device.bytesPerAddressEEPROM,
+                              flash ? device.bytesPerWordFLASH : device.bytesPerWordEEPROM,
+                              range.end, range.pDataBuffer);
+        verifyBytes += range.dataBufferLength;
+    }
+    readTime = Seconds(timer);
+    comm.setLatencySamples(NULL);
+
+    //The comparison on its own, with the same pairing of regions as Programmer::Verify().
+    timer.start();
+    foreach(DeviceData::MemoryRange deviceRange, deviceData.ranges)
+    {
+        if(deviceRange.type == CONFIG_MEMORY)
+        {
+            continue;
+        }
+        foreach(DeviceData::MemoryRange hexRange, hexData.ranges)
+        {
+            if(deviceRange.start != hexRange.start)
+            {
+                continue;
+            }
+            QByteArray careMask = device.CareMask(deviceRange.type, deviceRange.start, deviceRange.end);
+            mismatches += VerifyCompare(deviceRange.pDataBuffer, hexRange.pDataBuffer,
+                                        careMask.isEmpty() ? 0 : (const unsigned char*)careMask.constData(),
+                                        deviceRange.dataBufferLength, NULL);
+        }
+    }
+    compareTime = Seconds(timer);
+    phases["verify"] = readTime + compareTime;
+    phases["verifyCompare"] = compareTime;
+
+    timer.start();
+    if(result == Comm::Success)
+    {
+        result = comm.SignFlash();
+    }
+    phases["sign"] = Seconds(timer);
+
+    comm.close();
+
+    run["result"] = Comm::ErrorString(result);
+    run["mismatches"] = mismatches;
+    run["imageBytes"] = QFileInfo(fileName).size();
+    run["phases"] = phases;
+    run["program"] = TransferStats(programSamples, programBytes, programTime);
+    run["verify"] = TransferStats(verifySamples, verifyBytes, readTime);
+
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+
+    *ok = (result == Comm::Success) && (mismatches == 0);
+    return run;
+}
+
+//Looks for LS2014.hex in the working directory and the few above it, which covers
+//running from the source tree and from the build output directories.
+static QString FindDefaultHex(void)
+{
+    QDir dir = QDir::current();
+
+    for(int i = 0; i < 5; i++)
+    {
+        if(dir.exists("LS2014.hex"))
+        {
+            return dir.filePath("LS2014.hex");
+        }
+        if(!dir.cdUp())
+        {
+            break;
+        }
+    }
+    return QString();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("LSEBench");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Programming throughput benchmark against the HID bootloader simulator.\n"
+                                     "Simulator timing comes from the HIDSIM_* environment variables.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("hex", "Hex files to program (default: LS2014.hex).", "[hex...]");
+
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON results to <file>.", "file", "LSEBench.json");
+    QCommandLineOption repeatOption("repeat", "Run every image <count> times.", "count", "1");
+    QCommandLineOption noSyntheticOption("no-synthetic", "Skip the synthetic 64 KB and 128 KB images.");
+    QCommandLineOption writeWindowOption("write-window", "PROGRAM_DEVICE packets kept in flight.", "packets", QString::number(Comm::DefaultWriteWindow));
+    QCommandLineOption readAheadOption("read-ahead", "GET_DATA requests kept in flight.", "packets", QString::number(Comm::DefaultReadAheadWindow));
+    parser.addOption(outputOption);
+    parser.addOption(repeatOption);
+    parser.addOption(noSyntheticOption);
+    parser.addOption(writeWindowOption);
+    parser.addOption(readAheadOption);
+
+    parser.process(a);
+
+    QList<QPair<QString, QString> > images;
+    QStringList files = parser.positionalArguments();
+    if(files.isEmpty())
+    {
+        QString defaultHex = FindDefaultHex();
+        if(!defaultHex.isEmpty())
+        {
+            files.append(defaultHex);
+        }
+    }
+    foreach(QString file, files)
+    {
+        images.append(qMakePair(QFileInfo(file).fileName(), file));
+    }
+
+    QTemporaryDir tempDir;
+    if(!parser.isSet(noSyntheticOption))
+    {
+        uint32_t sizes[] = { 64 * 1024, 128 * 1024 };
+        for(unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        {
+            QString name = QString("synthetic-%1k.hex").arg(sizes[i] / 1024);
+            QString file = tempDir.path() + "/" + name;
+            if(!WriteSyntheticHex(file, sizes[i]))
+            {
+                fprintf(stderr, "Could not write %s\n", file.toLocal8Bit().constData());
+                return 1;
+            }
+            images.append(qMakePair(name, file));
+        }
+    }
+
+    if(images.isEmpty())
+    {
+        fprintf(stderr, "No images to benchmark.\n");
+        return 1;
+    }
+
+    int repeat = qMax(1, parser.value(repeatOption).toInt());
+    int writeWindow = parser.value(writeWindowOption).toInt();
+    int readAheadWindow = parser.value(readAheadOption).toInt();
+    bool allOk = true;
+
+    QJsonObject sim;
+    const char* simVariables[] = { "HIDSIM_LATENCY_US", "HIDSIM_PROGRAM_US", "HIDSIM_ERASE_PAGE_US", "HIDSIM_LOSS", "HIDSIM_SEED" };
+    for(unsigned int i = 0; i < sizeof(simVariables) / sizeof(simVariables[0]); i++)
+    {
+        if(qEnvironmentVariableIsSet(simVariables[i]))
+        {
+            sim[simVariables[i]] = QString(qgetenv(simVariables[i]));
+        }
+    }
+
+    QJsonArray runs;
+    for(int n = 0; n < repeat; n++)
+    {
+        for(int i = 0; i < images.count(); i++)
+        {
+            bool ok;
+            QJsonObject run = RunImage(images.at(i).first, images.at(i).second, writeWindow, readAheadWindow, &ok);
+            QJsonObject phases = run["phases"].toObject();
+            QJsonObject program = run["program"].toObject();
+            QJsonObject verify = run["verify"].toObject();
+
+            run["iteration"] = n;
+            runs.append(run);
+            allOk = allOk && ok;
+
+            printf("%-20s %s  erase %.3fs  program %.3fs (%.0f B/s, p50 %lldus p99 %lldus)  verify %.3fs (%.0f B/s, p50 %lldus p99 %lldus)  sign %.3fs\n",
+                   images.at(i).first.toLocal8Bit().constData(),
+                   ok ? "ok  " : "FAIL",
+                   phases["erase"].toDouble(),
+                   phases["program"].toDouble(), program["bytesPerSecond"].toDouble(),
+                   (long long)program["latencyUs"].toObject()["p50"].toDouble(),
+                   (long long)program["latencyUs"].toObject()["p99"].toDouble(),
+                   phases["verify"].toDouble(), verify["bytesPerSecond"].toDouble(),
+                   (long long)verify["latencyUs"].toObject()["p50"].toDouble(),
+                   (long long)verify["latencyUs"].toObject()["p99"].toDouble(),
+                   phases["sign"].toDouble());
+            fflush(stdout);
+        }
+    }
+
+    QJsonObject report;
+    report["version"] = QString(VERSION);
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["writeWindow"] = writeWindow;
+    report["readAheadWindow"] = readAheadWindow;
+    report["compareKernel"] = QString(VerifyCompareKernelName());
+    report["simulator"] = sim;
+    report["runs"] = runs;
+
+    QFile output(parser.value(outputOption));
+    if(!output.open(QIODevice::WriteOnly) || (output.write(QJsonDocument(report).toJson()) < 0))
+    {
+        fprintf(stderr, "Could not write %s\n", output.fileName().toLocal8Bit().constData());
+        return 1;
+    }
+
+    return allOk ? 0 : 2;
+}
@@ -4,45 +4,20 @@ QT += sql
 QT += widgets
 QMAKE_CXXFLAGS_RELEASE = -Os
 INCLUDEPATH += ../
+include(Core.pri)
 SOURCES += \
     Settings.cpp \
     MainWindow.cpp \
-    main.cpp \
-    DeviceData.cpp \
-    Device.cpp \
-    Comm.cpp \
-    ImportExportHex.cpp
+    main.cpp
 HEADERS += \
     Settings.h \
-    MainWindow.h \
-    DeviceData.h \
-    Device.h \
-    Comm.h \
-    ImportExportHex.h
+    MainWindow.h
 
 FORMS += MainWindow.ui \
     Settings.ui
 RESOURCES += resources.qrc
 OTHER_FILES += windows.rc
 
-#-------------------------------------------------
-# Add the correct HIDAPI library according to what
-# OS is being used
-#-------------------------------------------------
-win32: LIBS += -L../HIDAPI/windows
-macx: LIBS += -L../HIDAPI/mac
-unix: !macx: LIBS += -L../HIDAPI/linux
-LIBS += -lHIDAPI
-
-#-------------------------------------------------
-# Make sure to add the required libraries or
-# frameoworks for the hidapi to work depending on
-# what OS is being used
-#-------------------------------------------------
-macx: LIBS += -framework CoreFoundation -framework IOkit
-win32: LIBS += -lSetupAPI
-unix: !macx: LIBS += -lusb-1.0
-
 #-------------------------------------------------
 # Make sure output directory for object file and
 # executable is in the correct subdirectory
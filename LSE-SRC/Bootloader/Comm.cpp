@@ -32,6 +32,10 @@
 #include <QTime>
 
 const int Comm::SyncWaitTime = 40000;
+const int Comm::DefaultWriteWindow = 8;
+const int Comm::DefaultReadAheadWindow = 4;
+const int Comm::ReadAheadRetryTime = 2000;
+const int Comm::PageCrcProbeTime = 500;
 
 /**
  *
@@ -40,6 +44,9 @@ Comm::Comm()
 {
     connected = false;
     boot_device = NULL;
+    writeWindow = DefaultWriteWindow;
+    readAheadWindow = DefaultReadAheadWindow;
+    latencySamples = NULL;
 }
 
 /**
@@ -50,6 +57,28 @@ Comm::~Comm()
     boot_device = NULL;
 }
 
+/**
+ *
+ */
+QString Comm::ErrorString(ErrorCode errorCode)
+{
+    switch(errorCode)
+    {
+        case Success:
+            return "Success";
+        case NotConnected:
+            return "NotConnected";
+        case Fail:
+            return "Fail";
+        case IncorrectCommand:
+            return "IncorrectCommand";
+        case Timeout:
+            return "Timeout";
+        default:
+            return "Other";
+    }
+}
+
 /**
  *
  */
@@ -80,7 +109,9 @@ Comm::ErrorCode Comm::open(void)
     if(boot_device)
     {
         connected = true;
-        hid_set_nonblocking(boot_device, true);
+        //Leave the handle blocking: replies are waited for with hid_read_timeout(),
+        //so there is no need to poll a non-blocking handle in a tight loop.
+        hid_set_nonblocking(boot_device, false);
         qWarning("Device successfully connected to.");
         return Success;
     }
@@ -89,6 +120,25 @@ Comm::ErrorCode Comm::open(void)
     return NotConnected;
 }
 
+/**
+ * Opens one specific bootloader by its platform device path (as returned in
+ * hid_device_info::path), so several attached devices can be driven at once.
+ */
+Comm::ErrorCode Comm::open(const char *path)
+{
+    boot_device = hid_open_path(path);
+    if(boot_device)
+    {
+        connected = true;
+        hid_set_nonblocking(boot_device, false);
+        qWarning("Device %s successfully connected to.", path);
+        return Success;
+    }
+
+    qWarning("Unable to open device %s.", path);
+    return NotConnected;
+}
+
 /**
  *
  */
@@ -124,6 +174,30 @@ void Comm::Reset(void)
     }
 }
 
+//Sets how many PROGRAM_DEVICE/PROGRAM_COMPLETE packets Program() may have queued
+//in the USB stack at once.  A window of 1 makes every packet a full round trip.
+void Comm::setWriteWindow(int packets)
+{
+    writeWindow = (packets < 1) ? 1 : packets;
+}
+
+//Turns per-packet timing on (samples != NULL) or off.  While on, QueuePacket() appends the
+//time since the previous packet was queued and GetData() the round trip time of each GET_DATA
+//reply, both in microseconds.  Used by the benchmark tool.
+void Comm::setLatencySamples(QVector<qint64>* samples)
+{
+    latencySamples = samples;
+    latencyClock.start();
+    lastQueuedAt = 0;
+}
+
+//Sets how many GET_DATA requests GetData() keeps outstanding at once.  With a window of 1
+//every packet is a full request/reply round trip, as in earlier versions.
+void Comm::setReadAheadWindow(int packets)
+{
+    readAheadWindow = (packets < 1) ? 1 : packets;
+}
+
 /**
  *
  */
@@ -270,7 +344,7 @@ Comm::ErrorCode Comm::Program(uint32_t address, unsigned char bytesPerPacket,
                 qDebug("Sending program data packet with address: 0x%x", (uint32_t)writePacket.address);
 
                 //We need to send a normal PROGRAM_DEVICE packet worth of data to program.
-                result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+                result = QueuePacket((unsigned char*)&writePacket, sizeof(writePacket));
                 //Verify the data was successfully received by the USB device.
                 if(result != Success)
                 {
@@ -289,7 +363,7 @@ Comm::ErrorCode Comm::Program(uint32_t address, unsigned char bytesPerPacket,
                 writePacket.bytesPerPacket = 0;
                 firstAllFFPacketFound = false;
                 qDebug("Sending program complete data packet to skip a packet with address: 0x%x", (uint32_t)writePacket.address);
-                result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+                result = QueuePacket((unsigned char*)&writePacket, sizeof(writePacket));
                 //Verify the data was successfully received by the USB device.
                 if(result != Success)
                 {
@@ -329,11 +403,18 @@ Comm::ErrorCode Comm::Program(uint32_t address, unsigned char bytesPerPacket,
                 writePacket.bytesPerPacket = 0;
                 qDebug("Sending final program complete command for this region.");
 
-                result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+                result = QueuePacket((unsigned char*)&writePacket, sizeof(writePacket));
                 break;
             }
         }//while(address < endAddress)
 
+        //Wait for the queued packets to make it to the device, so that a failed write is
+        //reported here and not by whichever command happens to be sent next.
+        if(result == Success)
+        {
+            result = FlushPackets();
+        }
+
         return result;
 
     }//if(connected)
@@ -344,17 +425,30 @@ Comm::ErrorCode Comm::Program(uint32_t address, unsigned char bytesPerPacket,
 }
 
 /**
- *
+ * If sink is given it is handed every reply as it arrives, and the read stops with Fail as
+ * soon as the sink returns false.
  */
 Comm::ErrorCode Comm::GetData(uint32_t address, unsigned char bytesPerPacket,
                               unsigned char bytesPerAddress, unsigned char bytesPerWord,
-                              uint32_t endAddress, unsigned char *pData)
+                              uint32_t endAddress, unsigned char *pData, PacketSink* sink)
 {
     ReadPacket readPacket;
     WritePacket writePacket;
     ErrorCode result;
     uint32_t percentCompletion;
     uint32_t addressesToFetch = endAddress - address;
+    uint32_t addressesPerPacket;
+    uint32_t packetCount;
+    uint32_t packetsSent = 0;
+    uint32_t packetsReceived = 0;
+    uint32_t index;
+    uint32_t packetAddress;
+    int res;
+    int retries = 0;
+    uint32_t resent = 0;
+    uint32_t duplicates = 0;
+    QByteArray received;
+    QVector<qint64> sentAt;
 
     //Check to avoid possible division by zero when computing the percentage completion status.
     if(addressesToFetch == 0)
@@ -363,17 +457,126 @@ Comm::ErrorCode Comm::GetData(uint32_t address, unsigned char bytesPerPacket,
 
     if(connected) {
         //First error check the input parameters before using them
-        if((pData == NULL) || (endAddress < address) || (bytesPerPacket == 0))
+        if((pData == NULL) || (endAddress < address) || (bytesPerPacket == 0) || (bytesPerAddress == 0) ||
+           (bytesPerPacket < bytesPerAddress))
         {
             qWarning("Error, bad parameters provided to call of GetData()");
             return Fail;
         }
 
+        //Split the region into packets up front, so that replies can be matched back to the
+        //request they answer using the address the device echoes in ReadPacket.address.
+        addressesPerPacket = bytesPerPacket / bytesPerAddress;
+        packetCount = (endAddress - address + addressesPerPacket - 1) / addressesPerPacket;
+        received.fill(0, packetCount);
+        if(latencySamples != NULL)
+        {
+            sentAt.fill(0, packetCount);
+        }
+
         // Continue reading from device until the entire programmable region has been read
-        while(address < endAddress)
+        while(packetsReceived < packetCount)
         {
+            //Keep up to readAheadWindow GET_DATA requests outstanding, so the device always has
+            //the next request waiting while the reply to the current one is on the wire.
+            while((packetsSent < packetCount) && ((packetsSent - packetsReceived) < (uint32_t)readAheadWindow))
+            {
+                result = SendGetDataRequest(address + (packetsSent * addressesPerPacket), bytesPerPacket, bytesPerAddress, endAddress);
+                if(result != Success)
+                {
+                    return result;
+                }
+                if(latencySamples != NULL)
+                {
+                    sentAt[packetsSent] = latencyClock.nsecsElapsed();
+                }
+                packetsSent++;
+            }
+
+            // Read back the next reply from the device
+            memset((void*)&readPacket, 0x00, sizeof(readPacket));
+            res = hid_read_timeout(boot_device, (unsigned char*)&readPacket, sizeof(readPacket),
+                                   (readAheadWindow > 1) ? ReadAheadRetryTime : SyncWaitTime);
+            if(res == -1)
+            {
+                qWarning("Read failed.");
+                close();
+                return Fail;
+            }
+
+            if(res == 0)
+            {
+                //A request or its reply got lost.  Ask again for everything sent but not yet
+                //answered; a late original reply and the re-sent one are told apart by the
+                //received flags, so duplicates are simply dropped.
+                if(++retries > 3)
+                {
+                    qWarning("Timeout.");
+                    return Timeout;
+                }
+                qWarning("Timed out waiting for GET_DATA reply, re-sending outstanding requests (%lu input reports dropped so far).",
+                         hid_get_input_overflow(boot_device));
+                for(index = 0; index < packetsSent; index++)
+                {
+                    if(received.at(index) == 0)
+                    {
+                        result = SendGetDataRequest(address + (index * addressesPerPacket), bytesPerPacket, bytesPerAddress, endAddress);
+                        if(result != Success)
+                        {
+                            return result;
+                        }
+                        if(latencySamples != NULL)
+                        {
+                            sentAt[index] = latencyClock.nsecsElapsed();
+                        }
+                        resent++;
+                    }
+                }
+                continue;
+            }
+
+            //Work out which request this reply belongs to.  Anything that doesn't line up with
+            //an outstanding request (stale, duplicate or mangled) is dropped.
+            packetAddress = readPacket.address;
+            if((readPacket.command != GET_DATA) || (packetAddress < address) ||
+               (((packetAddress - address) % addressesPerPacket) != 0))
+            {
+                qWarning("Ignoring unexpected reply with address: 0x%x", packetAddress);
+                continue;
+            }
+            index = (packetAddress - address) / addressesPerPacket;
+            if((index >= packetsSent) || (received.at(index) != 0))
+            {
+                qWarning("Ignoring duplicate reply with address: 0x%x", packetAddress);
+                duplicates++;
+                continue;
+            }
+            if((readPacket.bytesPerPacket != ExpectedPacketSize(packetAddress, bytesPerPacket, bytesPerAddress, endAddress)))
+            {
+                qWarning("Ignoring short reply with address: 0x%x", packetAddress);
+                continue;
+            }
+
+            // Copy contents from packet to its place in the data buffer
+            memcpy(pData + (index * bytesPerPacket), readPacket.data + 58 - readPacket.bytesPerPacket, readPacket.bytesPerPacket);
+            received[index] = 1;
+            packetsReceived++;
+            if(latencySamples != NULL)
+            {
+                latencySamples->append((latencyClock.nsecsElapsed() - sentAt.at(index)) / 1000);
+            }
+            retries = 0;
+
+            if((sink != NULL) && !sink->PacketReceived(index * bytesPerPacket, readPacket.bytesPerPacket))
+            {
+                //The caller has seen enough.  Collect the replies still in flight, so they don't
+                //turn up in the middle of the next transfer.
+                DiscardGetDataReplies(address, endAddress, (packetsSent - packetsReceived) + (resent - duplicates));
+                return Fail;
+            }
+
             //Update the progress bar so the user knows things are happening.
-            percentCompletion = 100*((float)1 - (float)((float)(endAddress - address)/(float)addressesToFetch));
+            percentCompletion = 100*((float)packetsReceived/(float)packetCount);
             if(percentCompletion > 100)
             {
                 percentCompletion = 100;
@@ -383,62 +586,176 @@ Comm::ErrorCode Comm::GetData(uint32_t address, unsigned char bytesPerPacket,
             percentCompletion /= 3;
             percentCompletion += 67;
             emit SetProgressBar(percentCompletion);
+        }
 
+        //Every request that was re-sent may still get a second reply to the original.  Collect
+        //those now, or the next ReceivePacket() would take one for its own answer.
+        if(resent > duplicates)
+        {
+            DiscardGetDataReplies(address, endAddress, resent - duplicates);
+        }
 
-            // Set up the buffer packet with the appropriate address and with the get data command
-            memset((void*)&writePacket, 0x00, sizeof(writePacket));
-            writePacket.command = GET_DATA;
-            writePacket.address = address;
+        // if successfully received entire region, return success
+        return Success;
+    }
 
-            //Debug output info.
-            qWarning("Fetching packet with address: 0x%x", (uint32_t)writePacket.address);
+    // If not connected, return not connected
+    return NotConnected;
+}
 
-            // Calculate to see if the entire buffer can be filled with data, or just partially
-            if(((endAddress - address) * bytesPerAddress) < bytesPerPacket)
-                // If the amount of bytes left over between current address and end address is less than
-                //  the max amount of bytes per packet, then make sure the bytesPerPacket info is updated
-                writePacket.bytesPerPacket = (endAddress - address) * bytesPerAddress;
-            else
-                // Otherwise keep it at its maximum
-                writePacket.bytesPerPacket = bytesPerPacket;
+//Fetches the CRC-16 (CCITT, initial value 0xFFFF, as FirmwareBundle::Crc16) of pageCount consecutive
+//erase pages of pageSize addresses each, starting at address, into crcs[].  Each request covers up to
+//MAX_PAGE_CRCS_PER_PACKET pages; the reply echoes the address and page count, followed by the CRCs
+//as little endian words from data[0] on.
+//Bootloaders that predate GET_PAGE_CRC silently ignore it.  If the first reply does not arrive
+//within PageCrcProbeTime, IncorrectCommand is returned, so the caller can read the data back instead.
+Comm::ErrorCode Comm::GetPageCrcs(uint32_t address, uint32_t pageSize, uint32_t pageCount, uint16_t *crcs)
+{
+    WritePacket writePacket;
+    ReadPacket readPacket;
+    ErrorCode result;
+    uint32_t pagesDone = 0;
+    uint32_t i;
+    int res;
+    int retries = 0;
+    bool probing = true;
 
-            // Send the packet
-            result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+    if(!connected)
+    {
+        return NotConnected;
+    }
+    if((crcs == NULL) || (pageSize == 0))
+    {
+        qWarning("Error, bad parameters provided to call of GetPageCrcs()");
+        return Fail;
+    }
 
-            // If it wasn't successful, then return with error
-            if(result != Success)
-            {
-                qWarning("Error during verify sending packet with address: 0x%x", (uint32_t)writePacket.address);
-                return result;
-            }
+    while(pagesDone < pageCount)
+    {
+        memset((void*)&writePacket, 0x00, sizeof(writePacket));
+        writePacket.command = GET_PAGE_CRC;
+        writePacket.address = address + (pagesDone * pageSize);
+        writePacket.bytesPerPacket = qMin(pageCount - pagesDone, (uint32_t)MAX_PAGE_CRCS_PER_PACKET);
 
-            // Otherwise, read back the packet from the device
+        result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+        if(result != Success)
+        {
+            return result;
+        }
+
+        //Wait for the reply to this request, dropping anything stale that is still on its way.
+        do
+        {
             memset((void*)&readPacket, 0x00, sizeof(readPacket));
-            result = ReceivePacket((unsigned char*)&readPacket, sizeof(readPacket));
+            res = hid_read_timeout(boot_device, (unsigned char*)&readPacket, sizeof(readPacket),
+                                   probing ? PageCrcProbeTime : SyncWaitTime);
+        } while((res > 0) && ((readPacket.command != GET_PAGE_CRC) || (readPacket.address != writePacket.address)));
 
-            // If it wasn't successful, then return with error
-            if(result != Success)
+        if(res == -1)
+        {
+            qWarning("Read failed.");
+            close();
+            return Fail;
+        }
+        if(res == 0)
+        {
+            if(probing)
+            {
+                qDebug("No GET_PAGE_CRC reply, the bootloader does not support page CRCs.");
+                return IncorrectCommand;
+            }
+            if(++retries > 3)
             {
-                qWarning("Error reading packet with address: 0x%x", (uint32_t)readPacket.address);
-                return result;
+                qWarning("Timeout.");
+                return Timeout;
             }
+            continue;   //Ask for the same pages again.
+        }
+        if(readPacket.bytesPerPacket != writePacket.bytesPerPacket)
+        {
+            qWarning("Bad GET_PAGE_CRC reply with address: 0x%x", readPacket.address);
+            return Fail;
+        }
+
+        for(i = 0; i < writePacket.bytesPerPacket; i++)
+        {
+            crcs[pagesDone + i] = readPacket.data[2 * i] | (readPacket.data[(2 * i) + 1] << 8);
+        }
+        pagesDone += writePacket.bytesPerPacket;
+        probing = false;
+        retries = 0;
+    }
+
+    return Success;
+}
 
-            // Copy contents from packet to data pointer
-            memcpy(pData, readPacket.data + 58 - readPacket.bytesPerPacket, readPacket.bytesPerPacket);
+//Returns the payload size of the GET_DATA packet starting at address.  This is bytesPerPacket,
+//except for the final packet of a region, which only covers what is left up to endAddress.
+unsigned char Comm::ExpectedPacketSize(uint32_t address, unsigned char bytesPerPacket,
+                                       unsigned char bytesPerAddress, uint32_t endAddress)
+{
+    // Calculate to see if the entire buffer can be filled with data, or just partially
+    if(((endAddress - address) * bytesPerAddress) < bytesPerPacket)
+        // If the amount of bytes left over between current address and end address is less than
+        //  the max amount of bytes per packet, then make sure the bytesPerPacket info is updated
+        return (endAddress - address) * bytesPerAddress;
+
+    // Otherwise keep it at its maximum
+    return bytesPerPacket;
+}
 
-            // Increment data pointer
-            pData += readPacket.bytesPerPacket;
+//Reads and drops up to count late GET_DATA replies for addresses in [address, endAddress), left
+//in flight by an aborted or re-sent GetData().  Gives up as soon as no reply arrives within
+//ReadAheadRetryTime, since any reply still missing by then was lost along with its request.
+void Comm::DiscardGetDataReplies(uint32_t address, uint32_t endAddress, uint32_t count)
+{
+    ReadPacket readPacket;
 
-            // Increment address by however many bytes were received divided by how many bytes per address
-            address += readPacket.bytesPerPacket / bytesPerAddress;
+    while(count > 0)
+    {
+        memset((void*)&readPacket, 0x00, sizeof(readPacket));
+        if(hid_read_timeout(boot_device, (unsigned char*)&readPacket, sizeof(readPacket), ReadAheadRetryTime) <= 0)
+        {
+            return;
         }
+        if((readPacket.command == GET_DATA) && (readPacket.address >= address) && (readPacket.address < endAddress))
+        {
+            qWarning("Discarding late reply with address: 0x%x", (uint32_t)readPacket.address);
+            count--;
+        }
+        else
+        {
+            qWarning("Discarding unexpected reply with command: 0x%x", readPacket.command);
+        }
+    }
+}
 
-        // if successfully received entire region, return success
-        return Success;
+//Sends a single GET_DATA request for the packet starting at address.
+Comm::ErrorCode Comm::SendGetDataRequest(uint32_t address, unsigned char bytesPerPacket,
+                                         unsigned char bytesPerAddress, uint32_t endAddress)
+{
+    WritePacket writePacket;
+    ErrorCode result;
+
+    // Set up the buffer packet with the appropriate address and with the get data command
+    memset((void*)&writePacket, 0x00, sizeof(writePacket));
+    writePacket.command = GET_DATA;
+    writePacket.address = address;
+    writePacket.bytesPerPacket = ExpectedPacketSize(address, bytesPerPacket, bytesPerAddress, endAddress);
+
+    //Debug output info.
+    qWarning("Fetching packet with address: 0x%x", (uint32_t)writePacket.address);
+
+    // Send the packet
+    result = SendPacket((unsigned char*)&writePacket, sizeof(writePacket));
+
+    // If it wasn't successful, then return with error
+    if(result != Success)
+    {
+        qWarning("Error during verify sending packet with address: 0x%x", (uint32_t)writePacket.address);
     }
 
-    // If not connected, return not connected
-    return NotConnected;
+    return result;
 }
 
 /**
@@ -471,6 +788,32 @@ Comm::ErrorCode Comm::Erase(void) {
     return NotConnected;
 }
 
+//Erases the one flash erase page that contains address.  Only bootloaders that support
+//GET_PAGE_CRC know this command.  Like PROGRAM_DEVICE there is no reply, the device finishes the
+//erase before it takes the next packet off the bus.
+Comm::ErrorCode Comm::ErasePage(uint32_t address)
+{
+    WritePacket sendPacket;
+    ErrorCode status;
+
+    if(connected) {
+        memset((void*)&sendPacket, 0x00, sizeof(sendPacket));
+        sendPacket.command = ERASE_PAGE;
+        sendPacket.address = address;
+
+        qDebug("Erasing page with address: 0x%x", address);
+
+        status = SendPacket((unsigned char*)&sendPacket, sizeof(sendPacket));
+        if(status != Comm::Success)
+            qWarning("Erasing page with address 0x%x failed", address);
+
+        return status;
+    }
+
+    qDebug("Device not connected");
+    return NotConnected;
+}
+
 //Sends command to USB device to lock or unlock the config bit region.  If the config bits overlapped an
 //erase page with standard program memory, this will also affect the status of the erase page.  (for example
 //locking the config bits on a PIC18FxxJ or PIC24FJ device, which stores config bits at the end of the last page
@@ -723,24 +1066,55 @@ Comm::ErrorCode Comm::SendPacket(unsigned char *pData, int size)
 }
 
 
+//Hands a packet to the USB stack without waiting for it to be sent.  Up to writeWindow
+//packets may be outstanding; past that this blocks until the oldest one completes.
+//Packets are delivered to the device in the order they were queued.
+Comm::ErrorCode Comm::QueuePacket(unsigned char *pData, int size)
+{
+    if(hid_write_async(boot_device, pData, size, writeWindow) == -1)
+    {
+        qWarning("Queued write failed.");
+        close();
+        return Fail;
+    }
+    if(latencySamples != NULL)
+    {
+        qint64 now = latencyClock.nsecsElapsed();
+        latencySamples->append((now - lastQueuedAt) / 1000);
+        lastQueuedAt = now;
+    }
+    return Success;
+}
+
+//Waits for every packet queued by QueuePacket() to be sent.
+Comm::ErrorCode Comm::FlushPackets(void)
+{
+    if(hid_write_flush(boot_device) == -1)
+    {
+        qWarning("Queued write failed.");
+        close();
+        return Fail;
+    }
+    return Success;
+}
+
+
 Comm::ErrorCode Comm::ReceivePacket(unsigned char *data, int size)
 {
-    QTime timeoutTimer;
     int res = 0, timeout = 3;
 
-    timeoutTimer.start();
-
     while(res < 1)
     {
-        res = hid_read(boot_device, data, size);
+        //Sleep in the HID layer until a report arrives or SyncWaitTime expires,
+        //rather than spinning on a non-blocking read.
+        res = hid_read_timeout(boot_device, data, size, SyncWaitTime);
 
-        if(timeoutTimer.elapsed() > SyncWaitTime)
+        if(res == 0)
         {
-            timeoutTimer.start();
             timeout--;
         }
 
-        // If timed out twice, or return error then close device and return failure
+        // If timed out several times, or return error then close device and return failure
         if(timeout == 0)
         {
             qWarning("Timeout.");
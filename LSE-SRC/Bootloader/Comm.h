@@ -35,6 +35,8 @@
 
 #include <QThread>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
 
 #include "../HIDAPI/hidapi.h"
 #include "Device.h"
@@ -58,10 +60,15 @@
 #define RESET_DEVICE        0x08
 #define SIGN_FLASH			0x09	//The host PC application should send this command after the verify operation has completed successfully.  If checksums are used instead of a true verify (due to ALLOW_GET_DATA_COMMAND being commented), then the host PC application should send SIGN_FLASH command after is has verified the checksums are as exected. The firmware will then program the SIGNATURE_WORD into flash at the SIGNATURE_ADDRESS.
 #define QUERY_EXTENDED_INFO 0x0C    //Used by host PC app to get additional info about the device, beyond the basic NVM layout provided by the query device command
+#define GET_PAGE_CRC        0x0D    //Returns the CRC-16 of up to MAX_PAGE_CRCS_PER_PACKET consecutive flash erase pages, so the host can verify without reading the data back.  Older bootloaders ignore it.
+#define ERASE_PAGE          0x0E    //Erases the single flash erase page containing the given address.  Implemented by every bootloader that answers GET_PAGE_CRC.
 
 // Maximum number of memory regions that can be bootloaded
 #define MAX_DATA_REGIONS    0x06
 
+// Maximum number of page CRCs in one GET_PAGE_CRC reply (two bytes each in the 58 byte data field)
+#define MAX_PAGE_CRCS_PER_PACKET 29
+
 
 #define MAX_ERASE_BLOCK_SIZE 8196   //Increase this in the future if any microcontrollers with bigger than 8196 byte erase block is implemented
 
@@ -80,6 +87,11 @@ signals:
 protected:
     hid_device *boot_device;
     bool connected;
+    int writeWindow;
+    int readAheadWindow;
+    QVector<qint64>* latencySamples;
+    QElapsedTimer latencyClock;
+    qint64 lastQueuedAt;
 
 public:
 
@@ -87,13 +99,28 @@ public:
     ~Comm();
 
     static const int SyncWaitTime;
+    static const int DefaultWriteWindow;
+    static const int DefaultReadAheadWindow;
+    static const int ReadAheadRetryTime;
+    static const int PageCrcProbeTime;
 
     enum ErrorCode
     {
         Success = 0, NotConnected, Fail, IncorrectCommand, Timeout, Other = 0xFF
     };
 
-    QString ErrorString(ErrorCode errorCode) const;
+    static QString ErrorString(ErrorCode errorCode);
+
+    //Receives each GET_DATA reply as soon as GetData() has copied it into place, so the caller
+    //can work on it while the later replies are still in flight.
+    class PacketSink
+    {
+    public:
+        virtual ~PacketSink() {}
+
+        //offset and length are in bytes into GetData()'s buffer.  Returning false stops the read.
+        virtual bool PacketReceived(uint32_t offset, uint32_t length) = 0;
+    };
 
     #pragma pack(1)
     struct MemoryRegion
@@ -180,21 +207,33 @@ public:
     void PollUSB(void);
 
     ErrorCode open(void);
+    ErrorCode open(const char *path);
 
     void close(void);
     bool isConnected(void);
     void Reset(void);
+    void setWriteWindow(int packets);
+    void setReadAheadWindow(int packets);
+    void setLatencySamples(QVector<qint64>* samples);
 
     ErrorCode GetData(uint32_t address, unsigned char bytesPerPacket, unsigned char bytesPerAddress,
-                      unsigned char bytesPerWord, uint32_t endAddress, unsigned char *data);
+                      unsigned char bytesPerWord, uint32_t endAddress, unsigned char *data,
+                      PacketSink* sink = NULL);
+    ErrorCode GetPageCrcs(uint32_t address, uint32_t pageSize, uint32_t pageCount, uint16_t *crcs);
     ErrorCode Program(uint32_t address, unsigned char bytesPerPacket, unsigned char bytesPerAddress,
                       unsigned char bytesPerWord, unsigned char deviceFamily, uint32_t endAddress, unsigned char *data);
     ErrorCode Erase(void);
+    ErrorCode ErasePage(uint32_t address);
     ErrorCode LockUnlockConfig(bool lock);
     ErrorCode ReadBootloaderInfo(BootInfo* bootInfo);
     ErrorCode ReadExtendedQueryInfo(ExtendedQueryInfo* extendedBootInfo);
     ErrorCode SignFlash(void);
     ErrorCode SendPacket(unsigned char *data, int size);
+    ErrorCode SendGetDataRequest(uint32_t address, unsigned char bytesPerPacket, unsigned char bytesPerAddress, uint32_t endAddress);
+    void DiscardGetDataReplies(uint32_t address, uint32_t endAddress, uint32_t count);
+    static unsigned char ExpectedPacketSize(uint32_t address, unsigned char bytesPerPacket, unsigned char bytesPerAddress, uint32_t endAddress);
+    ErrorCode QueuePacket(unsigned char *data, int size);
+    ErrorCode FlushPackets(void);
     ErrorCode ReceivePacket(unsigned char *data, int size);
 };
 
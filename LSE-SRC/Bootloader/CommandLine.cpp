@@ -0,0 +1,583 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <stdio.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTime>
+
+#include "Comm.h"
+#include "DeviceData.h"
+#include "FirmwareBundle.h"
+#include "Device.h"
+#include "GangProgrammer.h"
+#include "HexCache.h"
+#include "ImportExportHex.h"
+#include "Programmer.h"
+
+#include "../version.h"
+
+//The LSE settings block lives in the first 0x40 bytes of data EEPROM (same layout as the GUI's .eep files).
+#define EEPROM_IMAGE_SIZE   0x40
+
+//Process exit codes.  With several devices the worst result wins.
+enum ExitCode
+{
+    ExitSuccess = 0, ExitUsage, ExitNoDevice, ExitFileError, ExitOperationFailed
+};
+
+static int ExitCodeFor(Comm::ErrorCode result)
+{
+    switch(result)
+    {
+        case Comm::Success:
+            return ExitSuccess;
+        case Comm::NotConnected:
+            return ExitNoDevice;
+        default:
+            return ExitOperationFailed;
+    }
+}
+
+//Every result is written to stdout as one compact JSON object per line.
+static void PrintResult(QJsonObject object)
+{
+    QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    fprintf(stdout, "%s\n", line.constData());
+    fflush(stdout);
+}
+
+static QJsonObject ResultObject(QString command, QString path, Comm::ErrorCode result, double time)
+{
+    QJsonObject object;
+
+    object["command"] = command;
+    object["device"] = path;
+    object["result"] = Comm::ErrorString(result);
+    object["code"] = (int)result;
+    object["time"] = time;
+    return object;
+}
+
+static QString RegionTypeName(unsigned char type)
+{
+    switch(type)
+    {
+        case PROGRAM_MEMORY:
+            return "program";
+        case EEPROM_MEMORY:
+            return "eeprom";
+        case CONFIG_MEMORY:
+            return "config";
+        default:
+            return "unknown";
+    }
+}
+
+static int Query(QString path)
+{
+    QTime elapsed;
+    Comm comm;
+    DeviceData deviceData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    Comm::ErrorCode result;
+    QJsonObject object;
+    QJsonArray regions;
+
+    elapsed.start();
+    result = comm.open(path.toLocal8Bit().constData());
+    if(result == Comm::Success)
+    {
+        result = programmer.Query();
+        comm.close();
+    }
+
+    object = ResultObject("query", path, result, (double)elapsed.elapsed() / 1000);
+    if(result == Comm::Success)
+    {
+        object["family"] = (int)device.family;
+        object["bytesPerPacket"] = (int)device.bytesPerPacket;
+        if(programmer.deviceFirmwareIsAtLeast101)
+        {
+            object["bootloaderVersion"] = (int)programmer.extendedBootInfo.PIC18.bootloaderVersion;
+            object["applicationVersion"] = (int)programmer.extendedBootInfo.PIC18.applicationVersion;
+        }
+        foreach(DeviceData::MemoryRange range, deviceData.ranges)
+        {
+            QJsonObject region;
+            region["type"] = RegionTypeName(range.type);
+            region["start"] = (qint64)range.start;
+            region["end"] = (qint64)range.end;
+            regions.append(region);
+        }
+        object["regions"] = regions;
+    }
+    PrintResult(object);
+
+    Programmer::FreeRanges(&deviceData);
+    return ExitCodeFor(result);
+}
+
+//Queries the device and works out where its settings block is: the first EEPROM_IMAGE_SIZE bytes
+//of the data EEPROM region it reports, as device addresses [*start, *end).
+static Comm::ErrorCode FindSettingsBlock(Programmer& programmer, Device& device, DeviceData& deviceData,
+                                         uint32_t* start, uint32_t* end)
+{
+    Comm::ErrorCode result;
+
+    result = programmer.Query();
+    if(result != Comm::Success)
+    {
+        return result;
+    }
+
+    foreach(DeviceData::MemoryRange range, deviceData.ranges)
+    {
+        if((range.type == EEPROM_MEMORY) &&
+           (((range.end - range.start) * device.bytesPerAddressEEPROM) >= EEPROM_IMAGE_SIZE))
+        {
+            *start = range.start;
+            *end = range.start + (EEPROM_IMAGE_SIZE / device.bytesPerAddressEEPROM);
+            return Comm::Success;
+        }
+    }
+
+    qWarning("The device has no data EEPROM that can hold the settings block.");
+    return Comm::Fail;
+}
+
+static int EepromRead(QString path, QString fileName)
+{
+    QTime elapsed;
+    Comm comm;
+    DeviceData deviceData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    Comm::ErrorCode result;
+    unsigned char data[EEPROM_IMAGE_SIZE];
+    uint32_t start;
+    uint32_t end;
+    QJsonObject object;
+    int exitCode;
+
+    elapsed.start();
+    result = comm.open(path.toLocal8Bit().constData());
+    if(result == Comm::Success)
+    {
+        result = FindSettingsBlock(programmer, device, deviceData, &start, &end);
+        if(result == Comm::Success)
+        {
+            result = comm.GetData(start, device.bytesPerPacket, device.bytesPerAddressEEPROM, device.bytesPerWordEEPROM, end, data);
+        }
+        comm.close();
+    }
+    Programmer::FreeRanges(&deviceData);
+
+    object = ResultObject("eeprom-read", path, result, (double)elapsed.elapsed() / 1000);
+    exitCode = ExitCodeFor(result);
+    if(result == Comm::Success)
+    {
+        object["data"] = QString(QByteArray((const char*)data, EEPROM_IMAGE_SIZE).toHex());
+        if(!fileName.isEmpty())
+        {
+            QFile file(fileName);
+            if(!file.open(QIODevice::WriteOnly) || (file.write((const char*)data, EEPROM_IMAGE_SIZE) != EEPROM_IMAGE_SIZE))
+            {
+                object["error"] = QString("Could not write " + fileName);
+                exitCode = ExitFileError;
+            }
+        }
+    }
+    PrintResult(object);
+
+    return exitCode;
+}
+
+static int EepromWrite(QString path, QByteArray image)
+{
+    QTime elapsed;
+    Comm comm;
+    DeviceData deviceData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    Comm::ErrorCode result;
+    unsigned char data[EEPROM_IMAGE_SIZE];
+    uint32_t start;
+    uint32_t end;
+
+    memcpy(data, image.constData(), EEPROM_IMAGE_SIZE);
+
+    elapsed.start();
+    result = comm.open(path.toLocal8Bit().constData());
+    if(result == Comm::Success)
+    {
+        result = FindSettingsBlock(programmer, device, deviceData, &start, &end);
+        if(result == Comm::Success)
+        {
+            result = comm.Program(start, device.bytesPerPacket, device.bytesPerAddressEEPROM, device.bytesPerWordEEPROM,
+                                  device.family, end, data);
+        }
+        if(result == Comm::Success)
+        {
+            //Read back and compare.
+            result = comm.GetData(start, device.bytesPerPacket, device.bytesPerAddressEEPROM, device.bytesPerWordEEPROM, end, data);
+            if((result == Comm::Success) && (memcmp(data, image.constData(), EEPROM_IMAGE_SIZE) != 0))
+            {
+                qWarning("EEPROM read back does not match the image written.");
+                result = Comm::Fail;
+            }
+        }
+        comm.close();
+    }
+    Programmer::FreeRanges(&deviceData);
+
+    PrintResult(ResultObject("eeprom-write", path, result, (double)elapsed.elapsed() / 1000));
+    return ExitCodeFor(result);
+}
+
+//Lays the hex file out for the device at path and saves it as a firmware bundle.
+static int ExportBundle(QString path, QString hexFileName, QString bundleFileName, QByteArray eepromTemplate, bool forceBinary, unsigned int binaryBaseAddress)
+{
+    QTime elapsed;
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    HexImporter::ErrorCode importResult = HexImporter::Success;
+    Comm::ErrorCode result;
+    QJsonObject object;
+    unsigned int pageSize;
+    int exitCode;
+
+    import.forceBinary = forceBinary;
+    import.binaryBaseAddress = binaryBaseAddress;
+
+    elapsed.start();
+    result = comm.open(path.toLocal8Bit().constData());
+    if(result == Comm::Success)
+    {
+        result = programmer.Query();
+        comm.close();
+    }
+
+    object = ResultObject("bundle", path, result, 0);
+    exitCode = ExitCodeFor(result);
+    if(result == Comm::Success)
+    {
+        importResult = programmer.ImportHexFile(hexFileName, &hexData, import);
+        if(importResult != HexImporter::Success)
+        {
+            object["importResult"] = (int)importResult;
+            exitCode = ExitFileError;
+        }
+        else
+        {
+            //Page CRCs over the device's own erase pages are the ones Verify() can use.
+            pageSize = programmer.ErasePageSize();
+            if(pageSize == 0)
+            {
+                pageSize = FirmwareBundle::DefaultPageSize;
+            }
+            if(!FirmwareBundle::Export(bundleFileName, &hexData, &device, import.hasConfigBits, eepromTemplate, pageSize))
+            {
+                object["error"] = QString("Could not write " + bundleFileName);
+                exitCode = ExitFileError;
+            }
+        }
+    }
+    object["time"] = (double)elapsed.elapsed() / 1000;
+    PrintResult(object);
+
+    Programmer::FreeRanges(&hexData);
+    Programmer::FreeRanges(&deviceData);
+    return exitCode;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setOrganizationName("Microchip");
+    QCoreApplication::setOrganizationDomain("microchip.com");
+    QCoreApplication::setApplicationName("LSECli");
+    QCoreApplication::setApplicationVersion(VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QString(APPLICATION) + " command line programmer.\n\n"
+                                     "Commands:\n"
+                                     "  query                  Report the bootloader's memory layout\n"
+                                     "  erase                  Erase the device\n"
+                                     "  blank-check            Check that the device is erased\n"
+                                     "  program <file.hex>     Erase, program and verify\n"
+                                     "  verify <file.hex>      Verify the device against a hex file\n"
+                                     "  eeprom-read [file.eep] Read the settings EEPROM\n"
+                                     "  eeprom-write <file>    Write the settings EEPROM from a .eep file or a bundle's template\n"
+                                     "  bundle <file.hex> <out.lfb> Convert a hex file to a binary firmware bundle\n"
+                                     "                         laid out for the attached device\n\n"
+                                     "Anywhere a hex file is expected, Motorola S-records, ELF32 executables (the\n"
+                                     "PT_LOAD segments at their load addresses), raw binaries (*.bin, or any file\n"
+                                     "with --binary-base) and firmware bundles (.lfb) work as well.\n"
+                                     "A hex file name of - reads the image from standard input.\n"
+                                     "Each result is printed to stdout as one JSON object per line.\n"
+                                     "Exit codes: 0 success, 1 usage, 2 no device, 3 file error, 4 operation failed.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("command", "Operation to run.");
+    parser.addPositionalArgument("file", "Hex or EEPROM image file.", "[file]");
+
+    QCommandLineOption allOption("all", "Run on every attached bootloader at once.");
+    QCommandLineOption deviceOption(QStringList() << "d" << "device", "Use the bootloader at this HID <path>.", "path");
+    QCommandLineOption listOption("list", "List attached bootloader paths and exit.");
+    QCommandLineOption noFlashOption("no-flash", "Do not program or verify program memory.");
+    QCommandLineOption noEepromOption("no-eeprom", "Do not program or verify data EEPROM.");
+    QCommandLineOption configOption("config", "Also program and verify the config bits.");
+    QCommandLineOption writeWindowOption("write-window", "PROGRAM_DEVICE packets kept in flight.", "packets", QString::number(Comm::DefaultWriteWindow));
+    QCommandLineOption readAheadOption("read-ahead", "GET_DATA requests kept in flight.", "packets", QString::number(Comm::DefaultReadAheadWindow));
+    QCommandLineOption eepromTemplateOption("eeprom-template", "bundle: include this .eep file as the EEPROM template.", "file");
+    QCommandLineOption binaryBaseOption("binary-base", "Load the file as a raw binary image starting at this hex file address (*.bin files default to 0).", "address");
+    QCommandLineOption deltaOption("delta", "program: only erase and program the flash pages that differ from the hex file.");
+    QCommandLineOption fullVerifyOption("full-verify", "Read all of program memory back when verifying, instead of comparing erase page CRCs.");
+    QCommandLineOption noCacheOption("no-cache", "Always parse the hex file, do not use or update the import cache.");
+    parser.addOption(allOption);
+    parser.addOption(deviceOption);
+    parser.addOption(listOption);
+    parser.addOption(noFlashOption);
+    parser.addOption(noEepromOption);
+    parser.addOption(configOption);
+    parser.addOption(writeWindowOption);
+    parser.addOption(readAheadOption);
+    parser.addOption(eepromTemplateOption);
+    parser.addOption(binaryBaseOption);
+    parser.addOption(deltaOption);
+    parser.addOption(fullVerifyOption);
+    parser.addOption(noCacheOption);
+
+    parser.process(a);
+    HexCache::setEnabled(!parser.isSet(noCacheOption));
+
+    bool forceBinary = parser.isSet(binaryBaseOption);
+    unsigned int binaryBaseAddress = 0;
+    if(forceBinary)
+    {
+        bool ok;
+        binaryBaseAddress = parser.value(binaryBaseOption).toUInt(&ok, 0);
+        if(!ok)
+        {
+            fprintf(stderr, "Invalid --binary-base address: %s\n", parser.value(binaryBaseOption).toLocal8Bit().constData());
+            return ExitUsage;
+        }
+    }
+
+    QStringList paths = GangProgrammer::Enumerate();
+    if(parser.isSet(listOption))
+    {
+        foreach(QString path, paths)
+        {
+            QJsonObject object;
+            object["device"] = path;
+            PrintResult(object);
+        }
+        return ExitSuccess;
+    }
+
+    QStringList args = parser.positionalArguments();
+    if(args.isEmpty())
+    {
+        fprintf(stderr, "No command given.\n\n%s", parser.helpText().toLocal8Bit().constData());
+        return ExitUsage;
+    }
+    QString command = args.at(0);
+    QString fileName = (args.count() > 1) ? args.at(1) : QString();
+
+    if(parser.isSet(deviceOption))
+    {
+        paths = QStringList(parser.value(deviceOption));
+    }
+    else if(!parser.isSet(allOption) && !paths.isEmpty())
+    {
+        paths = QStringList(paths.first());
+    }
+
+    if(paths.isEmpty())
+    {
+        PrintResult(ResultObject(command, QString(), Comm::NotConnected, 0));
+        return ExitNoDevice;
+    }
+
+    int exitCode = ExitSuccess;
+
+    if(command == "query")
+    {
+        foreach(QString path, paths)
+        {
+            exitCode = qMax(exitCode, Query(path));
+        }
+        return exitCode;
+    }
+
+    if(command == "eeprom-read")
+    {
+        if(!fileName.isEmpty() && (paths.count() > 1))
+        {
+            fprintf(stderr, "eeprom-read can only save to a file from a single device.\n");
+            return ExitUsage;
+        }
+        foreach(QString path, paths)
+        {
+            exitCode = qMax(exitCode, EepromRead(path, fileName));
+        }
+        return exitCode;
+    }
+
+    if(command == "eeprom-write")
+    {
+        QFile file(fileName);
+        QByteArray image;
+
+        if(fileName.isEmpty())
+        {
+            fprintf(stderr, "eeprom-write needs an EEPROM image file.\n");
+            return ExitUsage;
+        }
+        if(file.open(QIODevice::ReadOnly))
+        {
+            image = file.readAll();
+            if(FirmwareBundle::HasMagic(image.constData(), image.size()))
+            {
+                //The template points into image, so take a deep copy before replacing it.
+                QByteArray eepromTemplate = FirmwareBundle(image.constData(), image.size()).EepromTemplate();
+                image = QByteArray(eepromTemplate.constData(), eepromTemplate.size());
+            }
+            else
+            {
+                image.truncate(EEPROM_IMAGE_SIZE);
+            }
+        }
+        if(image.size() != EEPROM_IMAGE_SIZE)
+        {
+            fprintf(stderr, "Could not read %d bytes from %s.\n", EEPROM_IMAGE_SIZE, fileName.toLocal8Bit().constData());
+            return ExitFileError;
+        }
+        foreach(QString path, paths)
+        {
+            exitCode = qMax(exitCode, EepromWrite(path, image));
+        }
+        return exitCode;
+    }
+
+    if(command == "bundle")
+    {
+        QString bundleFileName = (args.count() > 2) ? args.at(2) : QString();
+        QByteArray eepromTemplate;
+
+        if(fileName.isEmpty() || bundleFileName.isEmpty())
+        {
+            fprintf(stderr, "bundle needs a hex file and an output file.\n");
+            return ExitUsage;
+        }
+        if(parser.isSet(eepromTemplateOption))
+        {
+            QFile file(parser.value(eepromTemplateOption));
+            if(file.open(QIODevice::ReadOnly))
+            {
+                eepromTemplate = file.read(EEPROM_IMAGE_SIZE);
+            }
+            if(eepromTemplate.size() != EEPROM_IMAGE_SIZE)
+            {
+                fprintf(stderr, "Could not read %d bytes from %s.\n", EEPROM_IMAGE_SIZE, file.fileName().toLocal8Bit().constData());
+                return ExitFileError;
+            }
+        }
+        return ExportBundle(paths.first(), fileName, bundleFileName, eepromTemplate, forceBinary, binaryBaseAddress);
+    }
+
+    GangProgrammer::Operation operation;
+    if(command == "erase")
+    {
+        operation = GangProgrammer::Erase;
+    }
+    else if(command == "blank-check")
+    {
+        operation = GangProgrammer::BlankCheck;
+    }
+    else if((command == "program") || (command == "verify"))
+    {
+        operation = (command == "program") ? GangProgrammer::Write : GangProgrammer::Verify;
+        if(fileName.isEmpty())
+        {
+            fprintf(stderr, "%s needs a hex file.\n", command.toLocal8Bit().constData());
+            return ExitUsage;
+        }
+        if((fileName == "-") && (paths.count() > 1))
+        {
+            //Every device imports the file itself, and standard input can only be read once.
+            fprintf(stderr, "Standard input can only be used with a single device.\n");
+            return ExitUsage;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Unknown command: %s\n", command.toLocal8Bit().constData());
+        return ExitUsage;
+    }
+
+    GangProgrammer gang;
+    gang.writeFlash = !parser.isSet(noFlashOption);
+    gang.writeEeprom = !parser.isSet(noEepromOption);
+    gang.writeConfig = parser.isSet(configOption);
+    gang.writeWindow = parser.value(writeWindowOption).toInt();
+    gang.readAheadWindow = parser.value(readAheadOption).toInt();
+    gang.crcVerify = !parser.isSet(fullVerifyOption);
+    gang.deltaWrite = parser.isSet(deltaOption);
+    gang.forceBinary = forceBinary;
+    gang.binaryBaseAddress = binaryBaseAddress;
+
+    foreach(GangProgrammer::Result result, gang.Run(operation, paths, fileName))
+    {
+        QJsonObject object = ResultObject(command, result.path, result.result, result.time);
+
+        if(result.importResult != HexImporter::Success)
+        {
+            object["importResult"] = (int)result.importResult;
+            exitCode = qMax(exitCode, (int)ExitFileError);
+        }
+        else
+        {
+            exitCode = qMax(exitCode, ExitCodeFor(result.result));
+        }
+        PrintResult(object);
+    }
+
+    return exitCode;
+}
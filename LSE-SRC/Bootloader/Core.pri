@@ -0,0 +1,52 @@
+#-------------------------------------------------
+# Device communication and hex file handling shared
+# by the GUI (Bootloader.pro) and the command line
+# tool (LSECli.pro).  No widgets in here.
+#-------------------------------------------------
+SOURCES += \
+    CpuFeatures.cpp \
+    DeviceData.cpp \
+    Device.cpp \
+    Comm.cpp \
+    ImportExportHex.cpp \
+    HexDecode.cpp \
+    VerifyCompare.cpp \
+    HexCache.cpp \
+    FirmwareBundle.cpp \
+    Programmer.cpp \
+    GangProgrammer.cpp
+HEADERS += \
+    CpuFeatures.h \
+    DeviceData.h \
+    Device.h \
+    Comm.h \
+    ImportExportHex.h \
+    HexDecode.h \
+    VerifyCompare.h \
+    HexCache.h \
+    FirmwareBundle.h \
+    Programmer.h \
+    GangProgrammer.h
+
+#-------------------------------------------------
+# Add the correct HIDAPI library according to what
+# OS is being used.  CONFIG+=hidsim links the
+# bootloader simulator instead (see HIDAPI.pro).
+#-------------------------------------------------
+hidsim {
+    LIBS += -L$$PWD/../HIDAPI/sim -lHIDAPI -lpthread
+} else {
+    win32: LIBS += -L$$PWD/../HIDAPI/windows
+    macx: LIBS += -L$$PWD/../HIDAPI/mac
+    unix: !macx: LIBS += -L$$PWD/../HIDAPI/linux
+    LIBS += -lHIDAPI
+
+    #-------------------------------------------------
+    # Make sure to add the required libraries or
+    # frameoworks for the hidapi to work depending on
+    # what OS is being used
+    #-------------------------------------------------
+    macx: LIBS += -framework CoreFoundation -framework IOkit
+    win32: LIBS += -lSetupAPI
+    unix: !macx: LIBS += -lusb-1.0
+}
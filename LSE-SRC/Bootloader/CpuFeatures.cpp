@@ -0,0 +1,68 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include "CpuFeatures.h"
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+bool CpuHasSSE2(void)
+{
+#if defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+    //May run before the compiler's own CPU detection.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#elif defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return false;
+#endif
+}
+
+bool CpuHasAVX2(void)
+{
+#if defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#elif defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    //The OS must also save the YMM registers on a context switch.
+    if(((info[2] & (1 << 27)) == 0) || ((_xgetbv(0) & 0x6) != 0x6))
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
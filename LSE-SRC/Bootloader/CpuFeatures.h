@@ -0,0 +1,64 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+//The SSE2/AVX2 kernels and the detection that picks them need intrinsics in target("avx2")
+//functions, which GCC has from 4.9 on (__builtin_cpu_supports() from 4.8).  Older compilers,
+//such as the MinGW 4.7 toolchain, build only the plain C++ kernels.  Clang also reports itself
+//as GCC 4.2, so it is checked first.
+#if defined(__clang__) || defined(_MSC_VER)
+#define CPU_FEATURES_COMPILER
+#elif defined(__GNUC__) && ((__GNUC__ > 4) || ((__GNUC__ == 4) && (__GNUC_MINOR__ >= 9)))
+#define CPU_FEATURES_COMPILER
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) && defined(CPU_FEATURES_COMPILER)
+#define CPU_FEATURES_X86
+#endif
+
+//Marks a function that uses instructions of the given instruction set, for example
+//CPU_TARGET("avx2").  GCC and Clang only emit SSE2/AVX2 instructions in functions that ask
+//for them, MSVC emits them anywhere.
+#if defined(CPU_FEATURES_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+/*!
+ * Run time CPU feature detection for picking a vector kernel.  Both are safe to
+ * call during static initialisation, and return false on other architectures and
+ * with compilers too old to build the vector kernels.
+ */
+bool CpuHasSSE2(void);
+
+//AVX2 is only reported if the OS also saves the YMM registers on a context switch.
+bool CpuHasAVX2(void);
+
+#endif // CPUFEATURES_H
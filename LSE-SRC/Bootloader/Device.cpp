@@ -76,130 +76,163 @@ bool Device::hasConfig(void)
     return false;
 }
 
-//This method is useful for hex file parsing.  This function checks if the address indicated in the hex
-//file line is contained in one of the programmable regions (ex: flash, eeprom, config words, etc.), as
-//specified by the USB device, (from the query response that we received earlier).  If the address
-//from the hex file is contained in the programmage device address range, this function returns
-//bool includedInProgrammableRange = true, with the type set to the programmable region type
-//(which can be determined based on the address and the query response).  This function also returns
-//the new effective device address (not from the .hex file, which is a raw linear byte address, but the
-//effective address the device should load into its self programming address registers, in order to
-//program the contents [PIC24 uses a 16-bit word addressed flash array, so the hex file addresses
-//don't match the microcontroller addresses]).
-//This function also returns bool addressWasEndofRange = true, if the input hexAddress corresponded
-//to the very last byte of the last address of the programmable memory region that the hexAddress
-//corresponded to.  Otherwise this value returns false.  This provides an easy check later to
-//know when an end of a region has been completed during hex file parsing.
-
-unsigned int Device::GetDeviceAddressFromHexAddress(unsigned int hexAddress,  DeviceData* pData, unsigned char& type, bool& includedInProgrammableRange, bool& addressWasEndofRange, unsigned int& bytesPerAddressAndType, unsigned int& endDeviceAddressofRegion, unsigned char*& pPCRAMBuffer)
+//Returns how many .hex file bytes make up one device address in a region of the given type.
+unsigned int Device::GetBytesPerAddress(unsigned char type)
 {
-    DeviceData::MemoryRange range;
-    unsigned int flashAddress = hexAddress / bytesPerAddressFLASH;
-    unsigned int eepromAddress = hexAddress / bytesPerAddressEEPROM;
-    unsigned int configAddress = hexAddress / bytesPerAddressConfig;
-    unsigned char* pRAMDataBuffer;
-    unsigned int byteOffset;
+    switch(type)
+    {
+        case PROGRAM_MEMORY:
+            return bytesPerAddressFLASH;
+        case EEPROM_MEMORY:
+            return bytesPerAddressEEPROM;
+        case CONFIG_MEMORY:
+            return bytesPerAddressConfig;
+        default:
+            return 0;
+    }
+}
 
+//Returns the verify mask for the device addresses [start, end) of a region of the given type, one
+//byte per PC RAM buffer byte: 0xFF where the byte is implemented and has to match, 0x00 for
+//don't-care bytes.  An empty array means every byte matters.
+QByteArray Device::CareMask(unsigned char type, unsigned int start, unsigned int end)
+{
+    unsigned int bytesPerAddress = GetBytesPerAddress(type);
+    unsigned int address;
+    QByteArray mask;
 
-    //Loop for each of the previously identified programmable regions, based on the results of the
-    //previous Query device response packet.
-    foreach(range, pData->ranges)
+    if((family == PIC24) && (bytesPerAddress == 2) && ((type == PROGRAM_MEMORY) || (type == CONFIG_MEMORY)))
     {
-        //Find what address range the hex address seems to contained within (if any, could be none, in
-        //the case the .hex file contains info that is not part of the bootloader re-programmable region of flash).
-        if((range.type == PROGRAM_MEMORY) && (flashAddress >= range.start) && (flashAddress < range.end))
+        //The upper byte of each odd address 16-bit word is the unimplemented "phantom byte".  It is
+        //probably 0x00 in the .hex file, or 0xFF where the file left a gap, and reads back as 0x00.
+        mask.fill((char)0xFF, (end - start) * bytesPerAddress);
+        for(address = start | 1; address < end; address += 2)
         {
-            includedInProgrammableRange = true;
-            if(range.start != 0)
-            {
-                byteOffset = ((flashAddress - range.start) * bytesPerAddressFLASH) + (hexAddress % bytesPerAddressFLASH);
-                pRAMDataBuffer = range.pDataBuffer + byteOffset;
-                pPCRAMBuffer = pRAMDataBuffer;
-            }
-            else
+            mask[((address - start) * bytesPerAddress) + 1] = 0x00;
+        }
+    }
+    else if((family == PIC18) && (type == CONFIG_MEMORY) && (start == 0x300000))
+    {
+        //CONFIG3L and CONFIG4H (0x300004 and 0x300007) are unimplemented on PIC18 non-J USB devices.
+        mask.fill((char)0xFF, (end - start) * bytesPerAddress);
+        for(address = 0x300004; address <= 0x300007; address += 3)
+        {
+            if(address < end)
             {
-                pPCRAMBuffer = 0;
+                mask[address - start] = 0x00;
             }
+        }
+    }
 
-            type = PROGRAM_MEMORY;
-            bytesPerAddressAndType = bytesPerAddressFLASH;
-            endDeviceAddressofRegion = range.end;
-            //Check if this was the very last byte of the very last address of the region.
-            //We can determine this, using the below check.
-            if((flashAddress == (range.end - 1)) && ((hexAddress % bytesPerAddressFLASH) == (bytesPerAddressFLASH - 1)))
-            {
-                addressWasEndofRange = true;
-            }
-            else
-            {
-                addressWasEndofRange = false;
-            }
-            return flashAddress;
+    return mask;
+}
+
+//Converts the programmable regions in pData (as reported by the query response) into .hex file
+//address space.  A device address range [start, end) covers the .hex file addresses
+//[start * bytesPerAddress, end * bytesPerAddress), and the PC RAM buffer holds those bytes in
+//order, so no division is needed when a record is placed later.
+//If two ranges overlap in .hex file address space, the one listed first in pData wins.
+void HexAddressIndex::Build(Device* device, DeviceData* pData)
+{
+    DeviceData::MemoryRange range;
+    QVector<Region> pieces;
+    QVector<Region> remaining;
+    unsigned int bytesPerAddress;
+    int existing;
+    int i;
+    int r;
+
+    regions.clear();
+
+    for(r = 0; r < pData->ranges.count(); r++)
+    {
+        range = pData->ranges[r];
+        bytesPerAddress = device->GetBytesPerAddress(range.type);
+        if((bytesPerAddress == 0) || (range.end <= range.start))
+        {
+            continue;
         }
 
-        if((range.type == EEPROM_MEMORY) && (eepromAddress >= range.start) && (eepromAddress < range.end))
+        Region region;
+        region.hexStart = (quint64)range.start * bytesPerAddress;
+        region.hexEnd = (quint64)range.end * bytesPerAddress;
+        region.type = range.type;
+        //A range starting at device address 0 was never given a usable buffer.
+        region.pDataBuffer = (range.start != 0) ? range.pDataBuffer : 0;
+        region.range = r;
+
+        //Only keep the parts of this range that no earlier range already covers.
+        pieces.clear();
+        pieces.append(region);
+        existing = regions.count();
+        for(i = 0; i < existing; i++)
         {
-            includedInProgrammableRange = true;
-            if(range.start != 0)
-            {
-                byteOffset = ((eepromAddress - range.start) * bytesPerAddressEEPROM)  + (hexAddress % bytesPerAddressEEPROM);
-                pRAMDataBuffer = range.pDataBuffer + byteOffset;
-                pPCRAMBuffer = pRAMDataBuffer;
-            }
-            else
-            {
-                pPCRAMBuffer = 0;
-            }
-            type = EEPROM_MEMORY;
-            bytesPerAddressAndType = bytesPerAddressEEPROM;
-            endDeviceAddressofRegion = range.end;
-            //Check if this was the very last byte of the very last address of the region.
-            //We can determine this, using the below check.
-            if((eepromAddress == (range.end - 1)) && ((eepromAddress % bytesPerAddressEEPROM) == (bytesPerAddressEEPROM - 1)))
-            {
-                addressWasEndofRange = true;
-            }
-            else
+            const Region covered = regions[i];
+
+            remaining.clear();
+            foreach(Region piece, pieces)
             {
-                addressWasEndofRange = false;
+                if((piece.hexEnd <= covered.hexStart) || (piece.hexStart >= covered.hexEnd))
+                {
+                    remaining.append(piece);
+                    continue;
+                }
+                if(piece.hexStart < covered.hexStart)
+                {
+                    Region before = piece;
+                    before.hexEnd = covered.hexStart;
+                    remaining.append(before);
+                }
+                if(piece.hexEnd > covered.hexEnd)
+                {
+                    Region after = piece;
+                    after.hexStart = covered.hexEnd;
+                    if(after.pDataBuffer != 0)
+                    {
+                        after.pDataBuffer += covered.hexEnd - piece.hexStart;
+                    }
+                    remaining.append(after);
+                }
             }
-            return eepromAddress;
+            pieces = remaining;
         }
+        regions += pieces;
+    }
 
-        if((range.type == CONFIG_MEMORY) && (configAddress >= range.start) && (configAddress < range.end))
+    //Insertion sort, there are only ever a handful of regions.
+    for(i = 1; i < regions.count(); i++)
+    {
+        Region region = regions[i];
+        int j = i;
+        while((j > 0) && (regions[j - 1].hexStart > region.hexStart))
         {
-            includedInProgrammableRange = true;
-            if(range.start != 0)
-            {
-                byteOffset = ((configAddress - range.start) * bytesPerAddressConfig) + (hexAddress % bytesPerAddressConfig);
-                pRAMDataBuffer = range.pDataBuffer + byteOffset;
-                pPCRAMBuffer = pRAMDataBuffer;
-            }
-            else
-            {
-                pPCRAMBuffer = 0;
-            }
-            type = CONFIG_MEMORY;
-            bytesPerAddressAndType = bytesPerAddressConfig;
-            endDeviceAddressofRegion = range.end;
-            //Check if this was the very last byte of the very last address of the region.
-            //We can determine this, using the below check.
-            if((configAddress == (range.end - 1)) && ((configAddress % bytesPerAddressConfig) == (bytesPerAddressConfig - 1)))
-            {
-                addressWasEndofRange = true;
-            }
-            else
-            {
-                addressWasEndofRange = false;
-            }
-            return configAddress;
+            regions[j] = regions[j - 1];
+            j--;
+        }
+        regions[j] = region;
+    }
+}
+
+//Returns the region containing hexAddress.  If no region contains it, returns the first region
+//above it, or 0 if there is none.
+const HexAddressIndex::Region* HexAddressIndex::Find(quint64 hexAddress) const
+{
+    int low = 0;
+    int high = regions.count();
+    int middle;
+
+    while(low < high)
+    {
+        middle = (low + high) / 2;
+        if(regions[middle].hexEnd <= hexAddress)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
         }
     }
 
-    //If we get to here, that means the hex file address that was passed in was not included in any of the
-    //device's reported programmable memory regions.
-    includedInProgrammableRange = false;
-    addressWasEndofRange = false;
-    pPCRAMBuffer = 0;
-    return 0;
+    return (low < regions.count()) ? &regions.constData()[low] : 0;
 }
@@ -31,6 +31,7 @@
 #include <QVariant>
 #include <QLinkedList>
 #include <QList>
+#include <QByteArray>
 
 #include "DeviceData.h"
 
@@ -71,10 +72,35 @@ public:
     bool hasConfigAsFlash(void);
     bool hasConfigAsFuses(void);
 
-    unsigned int GetDeviceAddressFromHexAddress(unsigned int hexAddress, DeviceData* pData, unsigned char& type, bool& includedInProgrammableRange, bool& addressWasEndofRange, unsigned int& bytesPerAddressAndType, unsigned int& endDeviceAddressofRegion, unsigned char*& pPCRAMBuffer);
+    unsigned int GetBytesPerAddress(unsigned char type);
+    QByteArray CareMask(unsigned char type, unsigned int start, unsigned int end);
 
 protected:
     DeviceData *deviceData;
 };
 
+/*!
+ * The programmable regions of a DeviceData laid out in .hex file (byte) address
+ * order, with each region's bytes per address already applied.  Lets the hex
+ * importer place a whole record with one lookup instead of searching every range
+ * for every byte.
+ */
+class HexAddressIndex
+{
+public:
+    struct Region
+    {
+        quint64 hexStart;           // first .hex file address in the region
+        quint64 hexEnd;             // one past the last .hex file address
+        unsigned char type;
+        unsigned char* pDataBuffer; // PC RAM byte for hexStart, 0 if the range starts at device address 0
+        int range;                  // index of the DeviceData range it belongs to
+    };
+
+    void Build(Device* device, DeviceData* pData);
+    const Region* Find(quint64 hexAddress) const;
+
+    QVector<Region> regions;        // sorted by hexStart, never overlapping
+};
+
 #endif // DEVICE_H
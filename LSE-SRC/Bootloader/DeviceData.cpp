@@ -33,8 +33,105 @@
 
 DeviceData::DeviceData()
 {
+    pageCrcSize = 0;
 }
 
 DeviceData::~DeviceData()
 {
 }
+
+//Marks the device addresses [start, end) of range as holding data, merging the new extent with
+//any it overlaps or touches.  Imports nearly always arrive in address order, so the new extent
+//usually just extends or follows the last one.
+void DeviceData::AddExtent(MemoryRange& range, unsigned int start, unsigned int end)
+{
+    Extent extent;
+    int first;
+    int last;
+
+    if(end <= start)
+    {
+        return;
+    }
+
+    //first is the earliest extent that ends at or after start, last the latest one that starts at
+    //or before end.  Everything from first to last merges with the new extent.
+    first = range.extents.count();
+    while((first > 0) && (range.extents[first - 1].end >= start))
+    {
+        first--;
+    }
+    last = first - 1;
+    while(((last + 1) < range.extents.count()) && (range.extents[last + 1].start <= end))
+    {
+        last++;
+    }
+
+    extent.start = start;
+    extent.end = end;
+    if(last >= first)
+    {
+        extent.start = qMin(start, range.extents[first].start);
+        extent.end = qMax(end, range.extents[last].end);
+        range.extents.remove(first, last - first + 1);
+    }
+    range.extents.insert(first, extent);
+}
+
+//Returns the extents of range widened to whole blocks of granularity device addresses, counted
+//from range.start and clipped to the range, and merged where the widening makes them meet.
+QVector<DeviceData::Extent> DeviceData::AlignedExtents(const MemoryRange& range, unsigned int granularity)
+{
+    QVector<Extent> aligned;
+    Extent block;
+
+    if(granularity == 0)
+    {
+        granularity = 1;
+    }
+
+    foreach(Extent extent, range.extents)
+    {
+        block.start = range.start + (((extent.start - range.start) / granularity) * granularity);
+        block.end = range.start + (((extent.end - range.start + granularity - 1) / granularity) * granularity);
+        if(block.end > range.end)
+        {
+            block.end = range.end;
+        }
+
+        if(!aligned.isEmpty() && (aligned.last().end >= block.start))
+        {
+            aligned.last().end = qMax(aligned.last().end, block.end);
+        }
+        else
+        {
+            aligned.append(block);
+        }
+    }
+
+    return aligned;
+}
+
+//Returns true if any of the device addresses [start, end) of range holds data.
+bool DeviceData::HasData(const MemoryRange& range, unsigned int start, unsigned int end)
+{
+    int low = 0;
+    int high = range.extents.count();
+    int middle;
+
+    //Find the first extent that ends after start.
+    while(low < high)
+    {
+        middle = (low + high) / 2;
+        if(range.extents[middle].end <= start)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return (start < end) && (low < range.extents.count()) && (range.extents[low].start < end);
+}
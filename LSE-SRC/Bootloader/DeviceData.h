@@ -35,6 +35,7 @@
 #define BOOTLOADER_V1_01_OR_NEWER_FLAG   0xA5   //Tacked on in region Type6 byte, to indicate when using newer version of bootloader with extended query info available
 
 
+#include <QHash>
 #include <QVector>
 
 
@@ -47,6 +48,13 @@ class DeviceData
         DeviceData();
         ~DeviceData();
 
+        //A run of device addresses [start, end) that holds data.
+        struct Extent
+        {
+            unsigned int start;
+            unsigned int end;
+        };
+
         struct MemoryRange
         {
             unsigned char type;
@@ -54,9 +62,22 @@ class DeviceData
             unsigned int end;
             unsigned int dataBufferLength;
             unsigned char* pDataBuffer;
+            //Sorted, disjoint and never touching.  pDataBuffer holds the blank value 0xFF
+            //everywhere else, so only these parts need to be programmed, verified or saved.
+            //Filled in by the importer; ranges read back from the device have none.
+            QVector<DeviceData::Extent> extents;
         };
 
+        static void AddExtent(MemoryRange& range, unsigned int start, unsigned int end);
+        static QVector<Extent> AlignedExtents(const MemoryRange& range, unsigned int granularity);
+        static bool HasData(const MemoryRange& range, unsigned int start, unsigned int end);
+
         QList<DeviceData::MemoryRange> ranges;
+
+        //CRC-16 of each pageCrcSize byte erase page of program memory, by the device address the
+        //page starts at, where the data came from a firmware bundle that had them precomputed.
+        QHash<unsigned int, quint16> pageCrcs;
+        unsigned int pageCrcSize;
 };
 
 #endif // DEVICEDATA_H
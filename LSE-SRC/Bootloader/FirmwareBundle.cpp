@@ -0,0 +1,384 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <QSaveFile>
+#include <string.h>
+
+#include "FirmwareBundle.h"
+
+#define BUNDLE_VERSION      1
+//Images and CRC tables start on this boundary within the file.
+#define BUNDLE_ALIGNMENT    16
+
+static const char bundleMagic[8] = {'L', 'S', 'E', 'F', 'W', 'B', 0, BUNDLE_VERSION};
+
+//CRC-16/CCITT (polynomial 0x1021), one table lookup per byte.
+static quint16 crcTable[256];
+
+static bool BuildCrcTable(void)
+{
+    for(int i = 0; i < 256; i++)
+    {
+        quint16 crc = i << 8;
+        for(int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+        crcTable[i] = crc;
+    }
+    return true;
+}
+
+static const bool crcTableBuilt = BuildCrcTable();
+
+quint16 FirmwareBundle::Crc16(const unsigned char* data, unsigned int length, quint16 crc)
+{
+    while(length--)
+    {
+        crc = (crc << 8) ^ crcTable[(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+static quint32 Align(quint32 offset)
+{
+    return (offset + (BUNDLE_ALIGNMENT - 1)) & ~(BUNDLE_ALIGNMENT - 1);
+}
+
+static bool Contains(qint64 length, quint32 offset, quint64 size)
+{
+    return ((quint64)offset + size) <= (quint64)length;
+}
+
+//Image bytes of region before the first erase page boundary, the part of a partial first page.
+static quint32 LeadingBytes(const FirmwareBundle::Region& region, quint32 pageSize)
+{
+    quint32 pageAddresses = pageSize / region.bytesPerAddress;
+
+    return (region.start % pageAddresses) * region.bytesPerAddress;
+}
+
+//Number of erase pages the image of region touches.
+static quint32 PageCount(const FirmwareBundle::Region& region, quint32 pageSize)
+{
+    return (LeadingBytes(region, pageSize) + region.dataLength + pageSize - 1) / pageSize;
+}
+
+FirmwareBundle::FirmwareBundle(const char* data, qint64 length)
+{
+    this->data = data;
+    this->length = length;
+    header = 0;
+    regions = 0;
+    valid = false;
+
+    if(!HasMagic(data, length) || !Contains(length, 0, sizeof(Header)))
+    {
+        return;
+    }
+    header = (const Header*)data;
+    if(!Contains(length, sizeof(Header), (quint64)header->regionCount * sizeof(Region)) ||
+       (header->pageSize == 0) ||
+       !Contains(length, header->eepromTemplateOffset, header->eepromTemplateLength))
+    {
+        return;
+    }
+    regions = (const Region*)(data + sizeof(Header));
+
+    //Every offset in the file is checked once here, so the accessors need not.
+    for(unsigned int i = 0; i < header->regionCount; i++)
+    {
+        const Region& region = regions[i];
+        if((region.end < region.start) ||
+           (region.bytesPerAddress == 0) || ((header->pageSize % region.bytesPerAddress) != 0) ||
+           ((quint64)(region.end - region.start) * region.bytesPerAddress != region.dataLength) ||
+           !Contains(length, region.dataOffset, region.dataLength) ||
+           (region.crcCount != PageCount(region, header->pageSize)) ||
+           !Contains(length, region.crcOffset, (quint64)region.crcCount * sizeof(quint16)) ||
+           ((region.crcOffset % sizeof(quint16)) != 0))
+        {
+            return;
+        }
+    }
+
+    valid = true;
+}
+
+bool FirmwareBundle::HasMagic(const char* data, qint64 length)
+{
+    return (length >= (qint64)sizeof(bundleMagic)) && (memcmp(data, bundleMagic, sizeof(bundleMagic)) == 0);
+}
+
+bool FirmwareBundle::isValid(void) const
+{
+    return valid;
+}
+
+unsigned int FirmwareBundle::RegionCount(void) const
+{
+    return valid ? header->regionCount : 0;
+}
+
+const FirmwareBundle::Region& FirmwareBundle::RegionAt(unsigned int index) const
+{
+    return regions[index];
+}
+
+const unsigned char* FirmwareBundle::Image(unsigned int index) const
+{
+    return (const unsigned char*)(data + regions[index].dataOffset);
+}
+
+const quint16* FirmwareBundle::PageCrcs(unsigned int index) const
+{
+    return (const quint16*)(data + regions[index].crcOffset);
+}
+
+//Returns the template without copying it, so it is only valid while the bundle bytes are.
+QByteArray FirmwareBundle::EepromTemplate(void) const
+{
+    if(!valid || (header->eepromTemplateLength == 0))
+    {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(data + header->eepromTemplateOffset, header->eepromTemplateLength);
+}
+
+//Copies the bundle images into the PC RAM buffers of pData (as allocated from the query
+//response), wherever a bundle region and a device range of the same type overlap.  Gives the
+//same results and errors HexImporter::ImportHexFile() would for the hex file it came from.
+//A bundle laid out for another device family is an error, its addresses mean something else.
+HexImporter::ErrorCode FirmwareBundle::Fill(DeviceData* pData, Device* device, bool& hasConfigBits) const
+{
+    unsigned int bytesPerAddress;
+    unsigned int start;
+    unsigned int end;
+    bool importedAtLeastOneByte = false;
+
+    hasConfigBits = false;
+    if(!valid || (header->family != (quint32)device->family))
+    {
+        return HexImporter::ErrorInHexFile;
+    }
+
+    for(int r = 0; r < pData->ranges.count(); r++)
+    {
+        DeviceData::MemoryRange& range = pData->ranges[r];
+        bytesPerAddress = device->GetBytesPerAddress(range.type);
+        for(unsigned int i = 0; i < header->regionCount; i++)
+        {
+            const Region& region = regions[i];
+            if((region.type != range.type) || (region.bytesPerAddress != bytesPerAddress))
+            {
+                continue;
+            }
+
+            start = qMax(region.start, range.start);
+            end = qMin(region.end, range.end);
+            if(start >= end)
+            {
+                continue;
+            }
+            if((range.start == 0) || (range.pDataBuffer == 0) ||
+               (((end - range.start) * bytesPerAddress) > range.dataBufferLength))
+            {
+                return HexImporter::InsufficientMemory;
+            }
+
+            memcpy(range.pDataBuffer + ((start - range.start) * bytesPerAddress),
+                   Image(i) + ((start - region.start) * bytesPerAddress),
+                   (end - start) * bytesPerAddress);
+            DeviceData::AddExtent(range, start, end);
+            if(range.type == PROGRAM_MEMORY)
+            {
+                StorePageCrcs(pData, i, start, end);
+            }
+            importedAtLeastOneByte = true;
+            if((range.type == CONFIG_MEMORY) && (header->flags & HasConfigBits))
+            {
+                hasConfigBits = true;
+            }
+        }
+    }
+
+    return importedAtLeastOneByte ? HexImporter::Success : HexImporter::NoneInRange;
+}
+
+//Hands the CRCs of the whole erase pages of region index inside the device addresses [start, end)
+//to pData, so Programmer doesn't have to work them out again for verify and delta programming.
+void FirmwareBundle::StorePageCrcs(DeviceData* pData, unsigned int index, unsigned int start, unsigned int end) const
+{
+    const Region& region = regions[index];
+    const quint16* crcs = PageCrcs(index);
+    quint32 pageAddresses = header->pageSize / region.bytesPerAddress;
+    quint32 leadingBytes = LeadingBytes(region, header->pageSize);
+    quint32 address;
+
+    pData->pageCrcSize = header->pageSize;
+    for(address = ((start + pageAddresses - 1) / pageAddresses) * pageAddresses; (address + pageAddresses) <= end; address += pageAddresses)
+    {
+        pData->pageCrcs.insert(address, crcs[(((address - region.start) * region.bytesPerAddress) + leadingBytes) / header->pageSize]);
+    }
+}
+
+//Writes the imported region images in hexData as a bundle.  Only the populated parts of each
+//range are saved, one bundle region per extent widened to whole pages, since Fill() leaves the
+//rest of a range blank anyway.  pageSize should be the device's flash erase page size, so that
+//Programmer can use the page CRCs.
+bool FirmwareBundle::Export(QString fileName, DeviceData* hexData, Device* device, bool hasConfigBits,
+                            QByteArray eepromTemplate, unsigned int pageSize)
+{
+    QList<Region> table;
+    QList<const unsigned char*> images;
+    QVector<DeviceData::Extent> widened;
+    DeviceData::MemoryRange range;
+    DeviceData::Extent block;
+    Header fileHeader;
+    quint32 offset;
+    unsigned int bytesPerAddress;
+    unsigned int pageAddresses;
+    QByteArray padding(BUNDLE_ALIGNMENT, 0);
+
+    if(pageSize == 0)
+    {
+        return false;
+    }
+
+    //Lay the file out: header, region table, then each image followed by its CRC table.
+    foreach(range, hexData->ranges)
+    {
+        bytesPerAddress = device->GetBytesPerAddress(range.type);
+        if((range.pDataBuffer == 0) || (bytesPerAddress == 0))
+        {
+            continue;
+        }
+        if((pageSize % bytesPerAddress) != 0)
+        {
+            return false;
+        }
+        pageAddresses = pageSize / bytesPerAddress;
+
+        //The region images are widened to whole erase pages at the device addresses they are
+        //erased at, not counted from the start of the range, so their page CRCs line up with the
+        //device's erase pages.
+        widened.clear();
+        foreach(DeviceData::Extent extent, range.extents)
+        {
+            block.start = qMax(range.start, extent.start - (extent.start % pageAddresses));
+            block.end = qMin(range.end, ((extent.end + pageAddresses - 1) / pageAddresses) * pageAddresses);
+            if(!widened.isEmpty() && (widened.last().end >= block.start))
+            {
+                widened.last().end = qMax(widened.last().end, block.end);
+            }
+            else
+            {
+                widened.append(block);
+            }
+        }
+
+        foreach(DeviceData::Extent extent, widened)
+        {
+            Region region;
+
+            region.type = range.type;
+            region.start = extent.start;
+            region.bytesPerAddress = bytesPerAddress;
+            region.dataLength = qMin(range.dataBufferLength - ((extent.start - range.start) * bytesPerAddress),
+                                     (extent.end - extent.start) * bytesPerAddress);
+            region.end = region.start + (region.dataLength / bytesPerAddress);
+            region.dataLength = (region.end - region.start) * bytesPerAddress;
+            if(region.dataLength == 0)
+            {
+                continue;
+            }
+            table.append(region);
+            images.append(range.pDataBuffer + ((extent.start - range.start) * bytesPerAddress));
+        }
+    }
+
+    offset = sizeof(Header) + (table.count() * sizeof(Region));
+    for(int i = 0; i < table.count(); i++)
+    {
+        Region& region = table[i];
+
+        region.dataOffset = Align(offset);
+        region.crcCount = PageCount(region, pageSize);
+        region.crcOffset = Align(region.dataOffset + region.dataLength);
+        offset = region.crcOffset + (region.crcCount * sizeof(quint16));
+    }
+
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    memcpy(fileHeader.magic, bundleMagic, sizeof(bundleMagic));
+    fileHeader.family = device->family;
+    fileHeader.regionCount = table.count();
+    fileHeader.flags = hasConfigBits ? HasConfigBits : 0;
+    fileHeader.pageSize = pageSize;
+    if(!eepromTemplate.isEmpty())
+    {
+        fileHeader.eepromTemplateOffset = Align(offset);
+        fileHeader.eepromTemplateLength = eepromTemplate.size();
+    }
+
+    QSaveFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+    file.write((const char*)&fileHeader, sizeof(fileHeader));
+    foreach(Region region, table)
+    {
+        file.write((const char*)&region, sizeof(region));
+    }
+
+    offset = sizeof(Header) + (table.count() * sizeof(Region));
+    for(int i = 0; i < table.count(); i++)
+    {
+        const Region& region = table.at(i);
+        const unsigned char* image = images.at(i);
+        quint32 leadingBytes = LeadingBytes(region, pageSize);
+
+        file.write(padding.constData(), region.dataOffset - offset);
+        file.write((const char*)image, region.dataLength);
+        file.write(padding.constData(), region.crcOffset - (region.dataOffset + region.dataLength));
+        for(unsigned int page = 0; page < region.crcCount; page++)
+        {
+            quint32 pageStart = (page == 0) ? 0 : ((page * pageSize) - leadingBytes);
+            quint32 pageEnd = qMin(((page + 1) * pageSize) - leadingBytes, region.dataLength);
+            quint16 crc = Crc16(image + pageStart, pageEnd - pageStart);
+            file.write((const char*)&crc, sizeof(crc));
+        }
+        offset = region.crcOffset + (region.crcCount * sizeof(quint16));
+    }
+
+    if(!eepromTemplate.isEmpty())
+    {
+        file.write(padding.constData(), fileHeader.eepromTemplateOffset - offset);
+        file.write(eepromTemplate);
+    }
+
+    return file.commit();
+}
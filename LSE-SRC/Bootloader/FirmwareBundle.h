@@ -0,0 +1,113 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef FIRMWAREBUNDLE_H
+#define FIRMWAREBUNDLE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "DeviceData.h"
+#include "Device.h"
+#include "ImportExportHex.h"
+
+/*!
+ * Binary firmware bundle (.lfb): the populated parts of the region images
+ * HexImporter produced for one device layout, each as its own page aligned
+ * region, a CRC-16 for every erase page of each image, and optionally
+ * the settings EEPROM template, in a form that can be used straight out of a
+ * memory mapped file.  All fields are little endian.
+ *
+ * Pages are pageSize bytes of image at device addresses that are a multiple
+ * of the page, the device's flash erase pages when it reported their size.
+ * A region cut off by the start or end of its range begins or ends with a
+ * partial page, whose CRC covers only the part in the image.
+ *
+ * A FirmwareBundle object is a read-only view of bundle bytes owned by the
+ * caller (normally a QFile mapping); nothing is copied until Fill().
+ */
+class FirmwareBundle
+{
+public:
+    enum { DefaultPageSize = 64 };
+
+    enum Flags
+    {
+        HasConfigBits = 0x01,
+    };
+
+    struct Header
+    {
+        char magic[8];
+        quint32 family;
+        quint32 regionCount;
+        quint32 flags;
+        quint32 pageSize;               // image bytes in each erase page
+        quint32 eepromTemplateOffset;
+        quint32 eepromTemplateLength;   // 0 if the bundle has no EEPROM template
+    };
+
+    struct Region
+    {
+        quint32 type;
+        quint32 start;                  // device addresses, as in DeviceData::MemoryRange
+        quint32 end;
+        quint32 bytesPerAddress;
+        quint32 dataOffset;             // image of (end - start) * bytesPerAddress bytes
+        quint32 dataLength;
+        quint32 crcOffset;              // one quint16 per erase page the image touches
+        quint32 crcCount;
+    };
+
+    FirmwareBundle(const char* data, qint64 length);
+
+    static bool HasMagic(const char* data, qint64 length);
+    bool isValid(void) const;
+
+    unsigned int RegionCount(void) const;
+    const Region& RegionAt(unsigned int index) const;
+    const unsigned char* Image(unsigned int index) const;
+    const quint16* PageCrcs(unsigned int index) const;
+    QByteArray EepromTemplate(void) const;
+
+    HexImporter::ErrorCode Fill(DeviceData* pData, Device* device, bool& hasConfigBits) const;
+
+    static bool Export(QString fileName, DeviceData* hexData, Device* device, bool hasConfigBits,
+                       QByteArray eepromTemplate = QByteArray(), unsigned int pageSize = DefaultPageSize);
+    static quint16 Crc16(const unsigned char* data, unsigned int length, quint16 crc = 0xFFFF);
+
+protected:
+    void StorePageCrcs(DeviceData* pData, unsigned int index, unsigned int start, unsigned int end) const;
+
+    const char* data;
+    qint64 length;
+    const Header* header;
+    const Region* regions;
+    bool valid;
+};
+
+#endif // FIRMWAREBUNDLE_H
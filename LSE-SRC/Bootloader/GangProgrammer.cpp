@@ -0,0 +1,204 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <QRunnable>
+#include <QTime>
+
+#include "GangProgrammer.h"
+#include "DeviceData.h"
+#include "Device.h"
+#include "Programmer.h"
+
+/*!
+ * One device's share of a gang operation.  Everything it touches is private
+ * to the worker, apart from its own slot in the result list.
+ */
+class GangWorker : public QRunnable
+{
+public:
+    GangWorker(GangProgrammer* gang, GangProgrammer::Operation operation, QString hexFileName, GangProgrammer::Result* result)
+    {
+        this->gang = gang;
+        this->operation = operation;
+        this->hexFileName = hexFileName;
+        this->result = result;
+    }
+
+    void run(void);
+
+protected:
+    GangProgrammer* gang;
+    GangProgrammer::Operation operation;
+    QString hexFileName;
+    GangProgrammer::Result* result;
+};
+
+void GangWorker::run(void)
+{
+    QTime elapsed;
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+
+    elapsed.start();
+    emit gang->DeviceStarted(result->path);
+
+    comm.setWriteWindow(gang->writeWindow);
+    comm.setReadAheadWindow(gang->readAheadWindow);
+    programmer.writeFlash = gang->writeFlash;
+    programmer.writeEeprom = gang->writeEeprom;
+    programmer.writeConfig = gang->writeConfig;
+    programmer.crcVerify = gang->crcVerify;
+    programmer.deltaWrite = gang->deltaWrite;
+    import.forceBinary = gang->forceBinary;
+    import.binaryBaseAddress = gang->binaryBaseAddress;
+
+    result->result = comm.open(result->path.toLocal8Bit().constData());
+    if(result->result != Comm::Success)
+    {
+        result->time = (double)elapsed.elapsed() / 1000;
+        emit gang->DeviceFinished(*result);
+        return;
+    }
+
+    //Config bits are locked by default; the GUI unlocks them when the user enables config programming.
+    if(programmer.writeConfig)
+    {
+        comm.LockUnlockConfig(false);
+    }
+
+    result->result = programmer.Query();
+    if((result->result == Comm::Success) && ((operation == GangProgrammer::Write) || (operation == GangProgrammer::Verify)))
+    {
+        result->importResult = programmer.ImportHexFile(hexFileName, &hexData, import);
+        if(result->importResult != HexImporter::Success)
+        {
+            result->result = Comm::Other;
+        }
+        else if(programmer.writeConfig && (import.hasConfigBits == false) && device.hasConfig())
+        {
+            //Same safety net as the GUI: never leave a device without config bits.
+            comm.LockUnlockConfig(true);
+            programmer.writeConfig = false;
+        }
+    }
+
+    if(result->result == Comm::Success)
+    {
+        switch(operation)
+        {
+            case GangProgrammer::Erase:
+                result->result = programmer.Erase();
+                break;
+            case GangProgrammer::Write:
+                result->result = programmer.Write(&hexData);
+                break;
+            case GangProgrammer::Verify:
+                result->result = programmer.Verify(&hexData);
+                break;
+            case GangProgrammer::BlankCheck:
+                result->result = programmer.BlankCheck();
+                break;
+        }
+    }
+
+    comm.close();
+    Programmer::FreeRanges(&hexData);
+    Programmer::FreeRanges(&deviceData);
+
+    result->time = (double)elapsed.elapsed() / 1000;
+    emit gang->DeviceFinished(*result);
+}
+
+GangProgrammer::GangProgrammer(QObject *parent) :
+    QObject(parent)
+{
+    writeFlash = true;
+    writeEeprom = true;
+    writeConfig = false;
+    writeWindow = Comm::DefaultWriteWindow;
+    readAheadWindow = Comm::DefaultReadAheadWindow;
+    crcVerify = true;
+    deltaWrite = false;
+    forceBinary = false;
+    binaryBaseAddress = 0;
+
+    qRegisterMetaType<Comm::ErrorCode>("Comm::ErrorCode");
+    qRegisterMetaType<GangProgrammer::Result>("GangProgrammer::Result");
+}
+
+//Returns the platform paths of every attached bootloader.
+QStringList GangProgrammer::Enumerate(void)
+{
+    QStringList paths;
+    hid_device_info *devs, *dev;
+
+    devs = hid_enumerate(VID, PID);
+    for(dev = devs; dev != NULL; dev = dev->next)
+    {
+        paths.append(QString::fromLocal8Bit(dev->path));
+    }
+    hid_free_enumeration(devs);
+
+    return paths;
+}
+
+QList<GangProgrammer::Result> GangProgrammer::Run(Operation operation, QStringList paths, QString hexFileName)
+{
+    QList<Result> results;
+    Result blank;
+
+    blank.result = Comm::NotConnected;
+    blank.importResult = HexImporter::Success;
+    blank.time = 0;
+    foreach(QString path, paths)
+    {
+        blank.path = path;
+        results.append(blank);
+    }
+
+    if(paths.isEmpty())
+    {
+        return results;
+    }
+
+    //hid_init() is not thread safe, so make sure it has run before the workers start.
+    hid_init();
+
+    //One thread per device: the workers spend nearly all their time blocked on USB.
+    pool.setMaxThreadCount(paths.count());
+    for(int i = 0; i < results.count(); i++)
+    {
+        pool.start(new GangWorker(this, operation, hexFileName, &results[i]));
+    }
+    pool.waitForDone();
+
+    return results;
+}
@@ -0,0 +1,90 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef GANGPROGRAMMER_H
+#define GANGPROGRAMMER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "Comm.h"
+#include "ImportExportHex.h"
+
+/*!
+ * Runs the same erase/program/verify/blank check operation on every attached
+ * bootloader at once.  Each device is opened by its own path and driven by a
+ * worker thread with its own Comm, Device, DeviceData and Programmer.
+ */
+class GangProgrammer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Operation { Erase = 0, Write, Verify, BlankCheck };
+
+    struct Result
+    {
+        QString path;
+        Comm::ErrorCode result;
+        HexImporter::ErrorCode importResult;
+        double time;
+    };
+
+    explicit GangProgrammer(QObject *parent = 0);
+
+    static QStringList Enumerate(void);
+
+    //Blocks until every device in paths has finished.  Results are returned
+    //in the same order as paths.
+    QList<Result> Run(Operation operation, QStringList paths, QString hexFileName = QString());
+
+    bool writeFlash;
+    bool writeEeprom;
+    bool writeConfig;
+    int writeWindow;
+    int readAheadWindow;
+    bool crcVerify;
+    bool deltaWrite;
+
+    //Passed on to each device's HexImporter.
+    bool forceBinary;
+    unsigned int binaryBaseAddress;
+
+signals:
+    void DeviceStarted(QString path);
+    void DeviceFinished(GangProgrammer::Result result);
+
+protected:
+    QThreadPool pool;
+
+    friend class GangWorker;
+};
+
+#endif // GANGPROGRAMMER_H
@@ -0,0 +1,294 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <string.h>
+
+#include "HexCache.h"
+
+//Bump whenever the entry layout or the importer's output for a given file changes.
+#define HEX_CACHE_VERSION       2
+//Oldest entries beyond this many are deleted when a new one is stored.
+#define HEX_CACHE_MAX_ENTRIES   32
+
+#define HEX_CACHE_END_OF_FILE   0x01
+#define HEX_CACHE_CONFIG_BITS   0x02
+
+//Entry file layout: this header, then for each range in DeviceData order its extent count, its
+//extents as start and end quint32 pairs, and the buffer bytes of those extents.
+struct HexCacheHeader
+{
+    char magic[8];
+    quint32 rangeCount;
+    quint32 flags;
+};
+
+static const char hexCacheMagic[8] = {'L', 'S', 'E', 'H', 'E', 'X', 0, HEX_CACHE_VERSION};
+
+static bool cacheEnabled = true;
+
+static QString CacheDirectory(void)
+{
+    QString path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+    if(path.isEmpty())
+    {
+        return QString();
+    }
+    return path + "/hex";
+}
+
+static QString EntryPath(const QByteArray& key)
+{
+    QString directory = CacheDirectory();
+
+    if(directory.isEmpty() || key.isEmpty())
+    {
+        return QString();
+    }
+    return directory + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+//Builds the lookup key for a hex file: its contents plus everything about the device that
+//decides where HexImporter puts each byte.
+QByteArray HexCache::Key(const char* fileData, qint64 fileLength, DeviceData* pData, Device* device)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    DeviceData::MemoryRange range;
+    quint32 layout[4];
+
+    hash.addData(hexCacheMagic, sizeof(hexCacheMagic));
+    hash.addData(fileData, fileLength);
+
+    layout[0] = device->family;
+    layout[1] = device->bytesPerAddressFLASH;
+    layout[2] = device->bytesPerAddressEEPROM;
+    layout[3] = device->bytesPerAddressConfig;
+    hash.addData((const char*)layout, sizeof(layout));
+
+    foreach(range, pData->ranges)
+    {
+        layout[0] = range.type;
+        layout[1] = range.start;
+        layout[2] = range.end;
+        layout[3] = range.dataBufferLength;
+        hash.addData((const char*)layout, sizeof(layout));
+    }
+
+    return hash.result().toHex();
+}
+
+//Fills the range buffers and extents in pData from the entry for key.  Returns false, leaving
+//pData untouched, if there is no usable entry.
+bool HexCache::Load(const QByteArray& key, DeviceData* pData, Device* device, bool& hasEndOfFileRecord, bool& hasConfigBits)
+{
+    QString path = EntryPath(key);
+    DeviceData::MemoryRange range;
+    HexCacheHeader header;
+    QList<QVector<DeviceData::Extent> > extents;
+    QList<const uchar*> images;
+    const uchar* entry;
+    const uchar* entryEnd;
+    const uchar* cursor;
+    quint32 extentCount;
+    quint32 imageLength;
+    unsigned int bytesPerAddress;
+    int r;
+
+    if(!cacheEnabled || path.isEmpty())
+    {
+        return false;
+    }
+
+    foreach(range, pData->ranges)
+    {
+        if((range.pDataBuffer == 0) || (device->GetBytesPerAddress(range.type) == 0))
+        {
+            return false;
+        }
+    }
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly) || (file.size() < (qint64)sizeof(HexCacheHeader)))
+    {
+        return false;
+    }
+    entry = file.map(0, file.size());
+    if(entry == 0)
+    {
+        return false;
+    }
+    entryEnd = entry + file.size();
+
+    memcpy(&header, entry, sizeof(header));
+    if((memcmp(header.magic, hexCacheMagic, sizeof(hexCacheMagic)) != 0) ||
+       (header.rangeCount != (quint32)pData->ranges.count()))
+    {
+        file.unmap((uchar*)entry);
+        return false;
+    }
+
+    //Check the whole entry before anything is copied.
+    cursor = entry + sizeof(header);
+    foreach(range, pData->ranges)
+    {
+        QVector<DeviceData::Extent> rangeExtents;
+
+        if((entryEnd - cursor) < (qint64)sizeof(extentCount))
+        {
+            file.unmap((uchar*)entry);
+            return false;
+        }
+        memcpy(&extentCount, cursor, sizeof(extentCount));
+        cursor += sizeof(extentCount);
+        if((quint64)(entryEnd - cursor) < ((quint64)extentCount * sizeof(DeviceData::Extent)))
+        {
+            file.unmap((uchar*)entry);
+            return false;
+        }
+        rangeExtents.resize(extentCount);
+        memcpy(rangeExtents.data(), cursor, extentCount * sizeof(DeviceData::Extent));
+        cursor += extentCount * sizeof(DeviceData::Extent);
+
+        imageLength = 0;
+        bytesPerAddress = device->GetBytesPerAddress(range.type);
+        foreach(DeviceData::Extent extent, rangeExtents)
+        {
+            if((extent.start < range.start) || (extent.end > range.end) || (extent.end <= extent.start) ||
+               (((extent.end - range.start) * bytesPerAddress) > range.dataBufferLength))
+            {
+                file.unmap((uchar*)entry);
+                return false;
+            }
+            imageLength += (extent.end - extent.start) * bytesPerAddress;
+        }
+        if((entryEnd - cursor) < (qint64)imageLength)
+        {
+            file.unmap((uchar*)entry);
+            return false;
+        }
+        extents.append(rangeExtents);
+        images.append(cursor);
+        cursor += imageLength;
+    }
+    if(cursor != entryEnd)
+    {
+        file.unmap((uchar*)entry);
+        return false;
+    }
+
+    for(r = 0; r < pData->ranges.count(); r++)
+    {
+        DeviceData::MemoryRange& target = pData->ranges[r];
+
+        bytesPerAddress = device->GetBytesPerAddress(target.type);
+        cursor = images.at(r);
+        target.extents = extents.at(r);
+        foreach(DeviceData::Extent extent, target.extents)
+        {
+            memcpy(target.pDataBuffer + ((extent.start - target.start) * bytesPerAddress), cursor,
+                   (extent.end - extent.start) * bytesPerAddress);
+            cursor += (extent.end - extent.start) * bytesPerAddress;
+        }
+    }
+    hasEndOfFileRecord = (header.flags & HEX_CACHE_END_OF_FILE) != 0;
+    hasConfigBits = (header.flags & HEX_CACHE_CONFIG_BITS) != 0;
+
+    file.unmap((uchar*)entry);
+    return true;
+}
+
+//Saves the populated parts of the range buffers in pData as the entry for key.  Failures are
+//not reported, the next import of the file just parses it again.
+void HexCache::Store(const QByteArray& key, DeviceData* pData, Device* device, bool hasEndOfFileRecord, bool hasConfigBits)
+{
+    QString path = EntryPath(key);
+    DeviceData::MemoryRange range;
+    HexCacheHeader header;
+    int i;
+
+    if(!cacheEnabled || path.isEmpty() || !QDir().mkpath(CacheDirectory()))
+    {
+        return;
+    }
+
+    memcpy(header.magic, hexCacheMagic, sizeof(hexCacheMagic));
+    header.rangeCount = pData->ranges.count();
+    header.flags = (hasEndOfFileRecord ? HEX_CACHE_END_OF_FILE : 0) | (hasConfigBits ? HEX_CACHE_CONFIG_BITS : 0);
+
+    //QSaveFile renames the finished entry into place, so a concurrent Load() never sees half of it.
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return;
+    }
+    file.write((const char*)&header, sizeof(header));
+    foreach(range, pData->ranges)
+    {
+        quint32 extentCount = range.extents.count();
+        unsigned int bytesPerAddress = device->GetBytesPerAddress(range.type);
+
+        if((range.pDataBuffer == 0) || (bytesPerAddress == 0))
+        {
+            file.cancelWriting();
+            break;
+        }
+
+        file.write((const char*)&extentCount, sizeof(extentCount));
+        file.write((const char*)range.extents.constData(), extentCount * sizeof(DeviceData::Extent));
+        foreach(DeviceData::Extent extent, range.extents)
+        {
+            file.write((const char*)range.pDataBuffer + ((extent.start - range.start) * bytesPerAddress),
+                       (extent.end - extent.start) * bytesPerAddress);
+        }
+    }
+    if(!file.commit())
+    {
+        return;
+    }
+
+    QFileInfoList entries = QDir(CacheDirectory()).entryInfoList(QStringList("*.bin"), QDir::Files, QDir::Time);
+    for(i = HEX_CACHE_MAX_ENTRIES; i < entries.count(); i++)
+    {
+        QFile::remove(entries[i].absoluteFilePath());
+    }
+}
+
+void HexCache::setEnabled(bool enable)
+{
+    cacheEnabled = enable;
+}
+
+bool HexCache::isEnabled(void)
+{
+    return cacheEnabled;
+}
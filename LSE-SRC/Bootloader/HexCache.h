@@ -0,0 +1,54 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef HEXCACHE_H
+#define HEXCACHE_H
+
+#include <QByteArray>
+
+#include "DeviceData.h"
+#include "Device.h"
+
+/*!
+ * On-disk cache of imported hex files.  An entry holds the populated extents of
+ * the PC RAM buffers HexImporter produced for one file's contents and one device
+ * memory layout, so importing the same firmware again for the same device is a
+ * hash and a copy out of a memory mapped file.  Entries are found by content, so
+ * an edited file just misses the cache.
+ */
+class HexCache
+{
+public:
+    static QByteArray Key(const char* fileData, qint64 fileLength, DeviceData* pData, Device* device);
+    static bool Load(const QByteArray& key, DeviceData* pData, Device* device, bool& hasEndOfFileRecord, bool& hasConfigBits);
+    static void Store(const QByteArray& key, DeviceData* pData, Device* device, bool hasEndOfFileRecord, bool hasConfigBits);
+
+    static void setEnabled(bool enable);
+    static bool isEnabled(void);
+};
+
+#endif // HEXCACHE_H
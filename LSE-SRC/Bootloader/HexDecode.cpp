@@ -0,0 +1,193 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include "HexDecode.h"
+#include "CpuFeatures.h"
+
+#ifdef CPU_FEATURES_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+typedef bool (*HexDecodeKernel)(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum);
+
+//Value of each ASCII hex digit, or 0xFF for any other character.
+static const unsigned char hexDigitValue[256] =
+{
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   //'0'-'9'
+    0xFF,0x0A,0x0B,0x0C,0x0D,0x0E,0x0F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   //'A'-'F'
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0x0A,0x0B,0x0C,0x0D,0x0E,0x0F,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   //'a'-'f'
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,
+    0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
+};
+
+static bool DecodeScalar(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum)
+{
+    unsigned char invalid = 0;
+    unsigned char total = *sum;
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        unsigned char high = hexDigitValue[(unsigned char)ascii[2 * i]];
+        unsigned char low = hexDigitValue[(unsigned char)ascii[(2 * i) + 1]];
+        invalid |= (high | low) & 0xF0;
+        binary[i] = (high << 4) | (low & 0x0F);
+        total += binary[i];
+    }
+
+    *sum = total;
+    return (invalid == 0);
+}
+
+#ifdef CPU_FEATURES_X86
+//Converts 16 ASCII characters into 8 bytes (in the low half of the result).
+//Clears *valid if any character is not a hex digit.
+CPU_TARGET("sse2")
+static inline __m128i DecodeBlockSSE2(__m128i chars, __m128i& valid)
+{
+    //'0'-'9' map to 0-9 and both cases of 'A'-'F' map to 0-5 after the subtraction,
+    //everything else lands above the limit (unsigned compare via min).
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+    valid = _mm_and_si128(valid, _mm_or_si128(isDigit, isAlpha));
+
+    __m128i nibbles = _mm_or_si128(_mm_and_si128(isDigit, digit),
+                                   _mm_and_si128(isAlpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+
+    //Each 16-bit lane holds (low nibble << 8) | high nibble.
+    __m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4);
+    __m128i low = _mm_srli_epi16(nibbles, 8);
+    return _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+}
+
+CPU_TARGET("sse2")
+static bool DecodeSSE2(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum)
+{
+    __m128i valid = _mm_set1_epi8((char)0xFF);
+    __m128i total = _mm_setzero_si128();
+    unsigned int i = 0;
+
+    for(; (i + 8) <= count; i += 8)
+    {
+        __m128i bytes = DecodeBlockSSE2(_mm_loadu_si128((const __m128i*)&ascii[2 * i]), valid);
+        _mm_storel_epi64((__m128i*)&binary[i], bytes);
+        total = _mm_add_epi64(total, _mm_sad_epu8(bytes, _mm_setzero_si128()));
+    }
+
+    if(_mm_movemask_epi8(valid) != 0xFFFF)
+    {
+        return false;
+    }
+
+    *sum += (unsigned char)_mm_cvtsi128_si32(total);
+    return DecodeScalar(&ascii[2 * i], &binary[i], count - i, sum);
+}
+
+CPU_TARGET("avx2")
+static bool DecodeAVX2(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum)
+{
+    __m256i valid = _mm256_set1_epi8((char)0xFF);
+    __m128i total = _mm_setzero_si128();
+    unsigned int i = 0;
+
+    for(; (i + 16) <= count; i += 16)
+    {
+        __m256i chars = _mm256_loadu_si256((const __m256i*)&ascii[2 * i]);
+        __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+        __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+        __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+        __m256i isAlpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+        valid = _mm256_and_si256(valid, _mm256_or_si256(isDigit, isAlpha));
+
+        __m256i nibbles = _mm256_or_si256(_mm256_and_si256(isDigit, digit),
+                                          _mm256_and_si256(isAlpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+        __m256i high = _mm256_slli_epi16(_mm256_and_si256(nibbles, _mm256_set1_epi16(0x00FF)), 4);
+        __m256i low = _mm256_srli_epi16(nibbles, 8);
+
+        //packus works per 128-bit lane, so gather the two 8 byte results into the low lane.
+        __m256i packed = _mm256_packus_epi16(_mm256_or_si256(high, low), _mm256_setzero_si256());
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        __m128i bytes = _mm256_castsi256_si128(packed);
+        _mm_storeu_si128((__m128i*)&binary[i], bytes);
+        total = _mm_add_epi64(total, _mm_sad_epu8(bytes, _mm_setzero_si128()));
+    }
+
+    if(_mm256_movemask_epi8(valid) != -1)
+    {
+        return false;
+    }
+
+    *sum += (unsigned char)(_mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total)));
+    return DecodeSSE2(&ascii[2 * i], &binary[i], count - i, sum);
+}
+
+#endif // CPU_FEATURES_X86
+
+//Runs during static initialisation.
+static HexDecodeKernel SelectKernel(const char** name)
+{
+#ifdef CPU_FEATURES_X86
+    if(CpuHasAVX2())
+    {
+        *name = "avx2";
+        return DecodeAVX2;
+    }
+    if(CpuHasSSE2())
+    {
+        *name = "sse2";
+        return DecodeSSE2;
+    }
+#endif
+    *name = "scalar";
+    return DecodeScalar;
+}
+
+static const char* kernelName;
+static const HexDecodeKernel kernel = SelectKernel(&kernelName);
+
+bool HexDecodePairs(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum)
+{
+    return kernel(ascii, binary, count, sum);
+}
+
+const char* HexDecodeKernelName(void)
+{
+    return kernelName;
+}
@@ -0,0 +1,45 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef HEXDECODE_H
+#define HEXDECODE_H
+
+/*!
+ * Converts count pairs of ASCII hex digits into count binary bytes, and adds
+ * every decoded byte to *sum (modulo 256) so the caller can validate a record
+ * checksum without a second pass.  Returns false if any of the 2 * count
+ * characters is not a hex digit; the output and *sum are then undefined.
+ *
+ * Uses an AVX2 or SSE2 kernel when the CPU supports it, chosen once at run
+ * time, and a lookup table otherwise.
+ */
+bool HexDecodePairs(const char* ascii, unsigned char* binary, unsigned int count, unsigned char* sum);
+
+//Name of the kernel HexDecodePairs() selected on this CPU ("avx2", "sse2" or "scalar").
+const char* HexDecodeKernelName(void);
+
+#endif // HEXDECODE_H
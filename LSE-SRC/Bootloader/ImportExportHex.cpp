@@ -33,12 +33,24 @@
 *************************************************************************/
 
 #include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 #include "ImportExportHex.h"
 #include "Device.h"
+#include "HexDecode.h"
+#include "HexCache.h"
+#include "FirmwareBundle.h"
 
 
 HexImporter::HexImporter(void)
 {
+    binaryBaseAddress = 0;
+    forceBinary = false;
+    recordWrites = true;
 }
 
 HexImporter::~HexImporter(void)
@@ -61,227 +73,925 @@ HexImporter::~HexImporter(void)
     to avoid overlapping with the HEX file's FLASH addresses.
 */
 
-//This function reads in Intel 32-bit .hex file formatted firmware image files and stores the
+//Longest legal Intel hex line: ':' + 2 count + 4 address + 2 type + 255 * 2 data + 2 checksum.
+#define HEX_MAX_LINE_LENGTH     (1 + 2 + 4 + 2 + (255 * 2) + 2)
+//Streaming line buffer: the longest line plus a CR LF line ending and readLine()'s terminator.
+#define HEX_LINE_BUFFER_SIZE    (HEX_MAX_LINE_LENGTH + 2 + 1)
+//Decoded record: byte count, address high, address low, record type, up to 255 data bytes, checksum.
+#define HEX_RECORD_HEADER_SIZE  4
+#define HEX_MAX_RECORD_SIZE     (HEX_RECORD_HEADER_SIZE + 255 + 1)
+//Read size for raw binary images that cannot be mapped.
+#define HEX_BINARY_BLOCK_SIZE   (16 * 1024)
+
+//Mapped files at least twice this size are imported in parallel, one slice per CPU core.
+#define HEX_PARALLEL_MIN_CHUNK  (1024 * 1024)
+
+/*!
+ * One slice of a memory mapped hex file, cut at line boundaries.  The first run
+ * scans the slice for extended address and end of file records.  Once the
+ * extended address in effect at its first line is known, the second run imports
+ * it with a private HexImporter sharing the parent's region index.
+ */
+class HexChunkWorker : public QRunnable
+{
+public:
+    HexChunkWorker(const char* data, qint64 length)
+    {
+        setAutoDelete(false);
+        this->data = data;
+        this->length = length;
+        scanOnly = true;
+        hasBaseAddress = false;
+        baseAddress = 0;
+        endOfFileLength = -1;
+        result = HexImporter::Success;
+    }
+
+    void run(void);
+
+    const char* data;
+    qint64 length;
+    bool scanOnly;
+
+    bool hasBaseAddress;            // slice contains a type 02 or 04 record
+    unsigned int baseAddress;       // address set by the last of them
+    qint64 endOfFileLength;         // slice length up to and including an END_OF_FILE record, or -1
+
+    HexImporter importer;
+    HexImporter::ErrorCode result;
+
+protected:
+    void Scan(void);
+};
+
+void HexChunkWorker::run(void)
+{
+    if(scanOnly)
+    {
+        Scan();
+    }
+    else
+    {
+        result = importer.ImportMappedRecords(data, length);
+    }
+}
+
+//Only looks at the record type (and the address of extended address records).  Everything
+//else, including the checksum, is checked when the slice is imported.
+void HexChunkWorker::Scan(void)
+{
+    const char* line = data;
+    const char* end = data + length;
+    const char* lineEnd;
+    const char* nextLine;
+    unsigned char record[HEX_RECORD_HEADER_SIZE + 2];
+    unsigned char checksum;
+
+    while(line < end)
+    {
+        lineEnd = (const char*)memchr(line, '\n', end - line);
+        nextLine = (lineEnd != 0) ? (lineEnd + 1) : end;
+        if(lineEnd == 0)
+        {
+            lineEnd = end;
+        }
+
+        if(((lineEnd - line) >= 2) && (line[0] == 'S') && (line[1] >= '7') && (line[1] <= '9'))
+        {
+            endOfFileLength = nextLine - data;
+            return;
+        }
+
+        checksum = 0;
+        if(((lineEnd - line) >= 11) && (line[0] == ':') &&
+           HexDecodePairs(&line[1], record, HEX_RECORD_HEADER_SIZE, &checksum))
+        {
+            if(record[3] == HexImporter::END_OF_FILE)
+            {
+                endOfFileLength = nextLine - data;
+                return;
+            }
+            if(((record[3] == HexImporter::EXTENDED_SEGMENT_ADDR) || (record[3] == HexImporter::EXTENDED_LINEAR_ADDR)) &&
+               (record[0] >= 2) && ((lineEnd - line) >= (11 + (2 * record[0]))) &&
+               HexDecodePairs(&line[1 + (2 * HEX_RECORD_HEADER_SIZE)], &record[HEX_RECORD_HEADER_SIZE], 2, &checksum))
+            {
+                hasBaseAddress = true;
+                baseAddress = (record[4] << 8) | record[5];
+                baseAddress <<= (record[3] == HexImporter::EXTENDED_SEGMENT_ADDR) ? 4 : 16;
+            }
+        }
+        line = nextLine;
+    }
+}
+
+static bool SpanStartsBefore(const HexImporter::WrittenSpan& a, const HexImporter::WrittenSpan& b)
+{
+    return a.start < b.start;
+}
+
+//Sorts spans by address and merges any that overlap or touch.
+static void MergeSpans(QVector<HexImporter::WrittenSpan>& spans)
+{
+    int merged = 0;
+
+    std::sort(spans.begin(), spans.end(), SpanStartsBefore);
+    for(int i = 1; i < spans.count(); i++)
+    {
+        if(spans[i].start <= spans[merged].end)
+        {
+            spans[merged].end = qMax(spans[merged].end, spans[i].end);
+        }
+        else
+        {
+            spans[++merged] = spans[i];
+        }
+    }
+    if(!spans.isEmpty())
+    {
+        spans.resize(merged + 1);
+    }
+}
+
+//This function reads in Intel 32-bit .hex file (or Motorola S-record, ELF32, raw binary or
+//firmware bundle) formatted firmware image files and stores the
 //parsed data into buffers in the PC system RAM, so that it is in a format more suitable for directly
 //programming into the target microcontroller.
+//Regular files are memory mapped.  Firmware bundles, ELF load segments and raw binaries are
+//copied straight out of the mapping, hex files and S-records are looked up in the HexCache, and otherwise parsed in place.
+//Pipes and standard input (fileName "-") are read a line at a time into a fixed buffer
+//instead.  Either way nothing is copied or allocated per record, and memory use does not
+//grow with the file size.
 HexImporter::ErrorCode HexImporter::ImportHexFile(QString fileName, DeviceData* pData, Device* device)
 {
-    QFile hexfile(fileName);
+    QFile hexfile;
+    uchar* mappedFile = 0;
+    QByteArray cacheKey;
+    ErrorCode result;
+    bool opened;
+    bool binary = forceBinary || fileName.endsWith(".bin", Qt::CaseInsensitive);
 
     hasEndOfFileRecord = false;
+    hasConfigBits = false;
     fileExceedsFlash = false;
+    segmentAddress = 0;
+    importedAtLeastOneByte = false;
+    writtenSpans.clear();
+    addressIndex.Build(device, pData);
+    pData->pageCrcs.clear();
+    pData->pageCrcSize = 0;
 
     //Open the user specified .hex file.
-    if (!hexfile.open(QIODevice::ReadOnly | QIODevice::Text))
+    if(fileName == "-")
+    {
+        opened = hexfile.open(stdin, QIODevice::ReadOnly);
+    }
+    else
+    {
+        hexfile.setFileName(fileName);
+        opened = hexfile.open(QIODevice::ReadOnly);
+    }
+    if(!opened)
     {
         return CouldNotOpenFile;
     }
 
-    bool ok;
-    bool includedInProgrammableRange;
-    bool addressWasEndofRange;
-    unsigned int segmentAddress = 0;
+    if((fileName != "-") && !hexfile.isSequential() && (hexfile.size() > 0))
+    {
+        mappedFile = hexfile.map(0, hexfile.size());
+    }
+
+    if((mappedFile != 0) && !binary && FirmwareBundle::HasMagic((const char*)mappedFile, hexfile.size()))
+    {
+        //A binary firmware bundle already holds the region images, no parsing needed.
+        FirmwareBundle bundle((const char*)mappedFile, hexfile.size());
+        result = bundle.Fill(pData, device, hasConfigBits);
+        hasEndOfFileRecord = bundle.isValid();
+        hexfile.unmap(mappedFile);
+        hexfile.close();
+        return result;
+    }
+
+    if(!binary && (mappedFile == 0) && IsElf(hexfile.peek(ELF_HEADER_SIZE).constData(), ELF_HEADER_SIZE))
+    {
+        //The program headers can be anywhere in an ELF file, so a piped one has to be read in whole.
+        QByteArray elf = hexfile.readAll();
+        result = ImportElf(elf.constData(), elf.size(), device);
+        hasEndOfFileRecord = true;
+    }
+    else if(!binary && IsElf((const char*)mappedFile, hexfile.size()))
+    {
+        //Compiler output goes straight in, there is no text to parse and nothing worth caching.
+        result = ImportElf((const char*)mappedFile, hexfile.size(), device);
+        hexfile.unmap(mappedFile);
+        hasEndOfFileRecord = true;
+    }
+    else if(binary)
+    {
+        //A raw image is the data itself, so there is nothing to cache and no end record.
+        if(mappedFile != 0)
+        {
+            result = ImportBinary((const char*)mappedFile, hexfile.size(), binaryBaseAddress);
+            hexfile.unmap(mappedFile);
+        }
+        else
+        {
+            result = ImportStreamedBinary(hexfile);
+        }
+        hasEndOfFileRecord = true;
+    }
+    else if(mappedFile != 0)
+    {
+        //The same firmware may well have been imported for this device layout before.
+        if(HexCache::isEnabled())
+        {
+            cacheKey = HexCache::Key((const char*)mappedFile, hexfile.size(), pData, device);
+            if(HexCache::Load(cacheKey, pData, device, hasEndOfFileRecord, hasConfigBits))
+            {
+                hexfile.unmap(mappedFile);
+                hexfile.close();
+                return Success;
+            }
+        }
+
+        result = ImportMappedFile((const char*)mappedFile, hexfile.size());
+        hexfile.unmap(mappedFile);
+    }
+    else
+    {
+        result = ImportStreamedRecords(hexfile);
+    }
+
+    //If we get to here, that means we reached the end of the hex file, or we found a END_OF_FILE record in the .hex file.
+    hexfile.close();
+    if(result != Success)
+    {
+        return result;
+    }
+
+    //Check if we imported any data from the .hex file.
+    if(importedAtLeastOneByte == true)
+    {
+        StoreExtents(pData, device);
+        if(!cacheKey.isEmpty())
+        {
+            HexCache::Store(cacheKey, pData, device, hasEndOfFileRecord, hasConfigBits);
+        }
+        //qDebug(QString("Hex File imported successfully.").toLatin1());
+        return Success;
+    }
+    else
+    {
+        //If we get to here, we didn't import anything.  The hex file must have been empty or otherwise didn't
+        //contain any data that overlaps a device programmable region.  We should let the user know they should
+        //supply a better hex file designed for their device.
+        return NoneInRange;
+    }
+}
+
+//Imports a memory mapped file.  Large files are cut into one slice per CPU core at line
+//boundaries and the slices imported in parallel, straight into the shared PC RAM buffers.
+HexImporter::ErrorCode HexImporter::ImportMappedFile(const char* data, qint64 length)
+{
+    QList<HexChunkWorker*> chunks;
+    QThreadPool pool;
+    QVector<WrittenSpan> written;
+    const char* end = data + length;
+    const char* start = data;
+    const char* cut;
+    unsigned int base;
+    ErrorCode result = Success;
+    int chunkCount = (int)qMin((qint64)QThread::idealThreadCount(), length / HEX_PARALLEL_MIN_CHUNK);
+    int i;
+
+    if(chunkCount < 2)
+    {
+        return ImportMappedRecords(data, length);
+    }
+
+    for(i = 1; (i <= chunkCount) && (start < end); i++)
+    {
+        cut = data + ((length * i) / chunkCount);
+        if(cut < start)
+        {
+            cut = start;
+        }
+        if(cut < end)
+        {
+            cut = (const char*)memchr(cut, '\n', end - cut);
+            cut = (cut != 0) ? (cut + 1) : end;
+        }
+        chunks.append(new HexChunkWorker(start, cut - start));
+        start = cut;
+    }
+
+    //Find the extended address records in every slice.
+    pool.setMaxThreadCount(chunks.count());
+    foreach(HexChunkWorker* chunk, chunks)
+    {
+        pool.start(chunk);
+    }
+    pool.waitForDone();
+
+    //Work out the extended address in effect at the start of each slice, and drop everything
+    //after the first END_OF_FILE record, since a sequential import stops there.
+    base = segmentAddress;
+    for(i = 0; i < chunks.count(); i++)
+    {
+        HexChunkWorker* chunk = chunks[i];
+
+        chunk->scanOnly = false;
+        chunk->importer.addressIndex = addressIndex;
+        chunk->importer.segmentAddress = base;
+        chunk->importer.hasEndOfFileRecord = false;
+        chunk->importer.hasConfigBits = false;
+        chunk->importer.importedAtLeastOneByte = false;
+        chunk->importer.recordWrites = true;
+
+        if(chunk->endOfFileLength >= 0)
+        {
+            chunk->length = chunk->endOfFileLength;
+            while(chunks.count() > (i + 1))
+            {
+                delete chunks.takeLast();
+            }
+            break;
+        }
+        if(chunk->hasBaseAddress)
+        {
+            base = chunk->baseAddress;
+        }
+    }
+
+    foreach(HexChunkWorker* chunk, chunks)
+    {
+        pool.start(chunk);
+    }
+    pool.waitForDone();
+
+    //Report the error a sequential import would have hit first.
+    foreach(HexChunkWorker* chunk, chunks)
+    {
+        if(result == Success)
+        {
+            result = chunk->result;
+        }
+        importedAtLeastOneByte |= chunk->importer.importedAtLeastOneByte;
+        hasConfigBits |= chunk->importer.hasConfigBits;
+        hasEndOfFileRecord |= chunk->importer.hasEndOfFileRecord;
+
+        MergeSpans(chunk->importer.writtenSpans);
+        written += chunk->importer.writtenSpans;
+        delete chunk;
+    }
+    if(result != Success)
+    {
+        return result;
+    }
+
+    //Each slice's spans are disjoint after merging, so any overlap here is between two slices
+    //that wrote the same address in no particular order.  Import the file again in order, so
+    //the last record in the file wins, as it does in a sequential import.
+    std::sort(written.begin(), written.end(), SpanStartsBefore);
+    for(i = 1; i < written.count(); i++)
+    {
+        if(written[i].start < written[i - 1].end)
+        {
+            segmentAddress = 0;
+            hasEndOfFileRecord = false;
+            hasConfigBits = false;
+            importedAtLeastOneByte = false;
+            return ImportMappedRecords(data, length);
+        }
+    }
+
+    writtenSpans = written;
+    return Success;
+}
+
+//Walks the records of a file that is already in memory, without copying any lines.
+HexImporter::ErrorCode HexImporter::ImportMappedRecords(const char* data, qint64 length)
+{
+    const char* end = data + length;
+    const char* lineEnd;
+    const char* nextLine;
+    ErrorCode result;
+
+    while(data < end)
+    {
+        lineEnd = (const char*)memchr(data, '\n', end - data);
+        nextLine = (lineEnd != 0) ? (lineEnd + 1) : end;
+        if(lineEnd == 0)
+        {
+            lineEnd = end;
+        }
+        while((lineEnd > data) && (lineEnd[-1] == '\r'))
+        {
+            lineEnd--;
+        }
+
+        result = ImportRecord(data, lineEnd - data);
+        if((result != Success) || hasEndOfFileRecord)
+        {
+            return result;
+        }
+        data = nextLine;
+    }
+
+    return Success;
+}
+
+//Reads records one line at a time from a file that cannot be mapped, such as a pipe.
+HexImporter::ErrorCode HexImporter::ImportStreamedRecords(QIODevice& file)
+{
+    char line[HEX_LINE_BUFFER_SIZE];
+    qint64 lineLength;
+    ErrorCode result;
+
+    while((lineLength = file.readLine(line, sizeof(line))) > 0)
+    {
+        if((line[lineLength - 1] != '\n') && !file.atEnd())
+        {
+            //Longer than any legal record.
+            return ErrorInHexFile;
+        }
+        while((lineLength > 0) && ((line[lineLength - 1] == '\n') || (line[lineLength - 1] == '\r')))
+        {
+            lineLength--;
+        }
+
+        result = ImportRecord(line, lineLength);
+        if((result != Success) || hasEndOfFileRecord)
+        {
+            return result;
+        }
+    }
+
+    return Success;
+}
+
+//Parses one line of the file (without its line ending) and stores any data it carries.
+//Lines starting with 'S' are Motorola S-records, everything else must be Intel hex.
+//Sets hasEndOfFileRecord when it finds the END_OF_FILE (or S7/S8/S9 termination) record.
+HexImporter::ErrorCode HexImporter::ImportRecord(const char* line, qint64 lineLength)
+{
+    if((lineLength > 0) && (line[0] == 'S'))
+    {
+        return ImportSRecord(line, lineLength);
+    }
+    return ImportIntelRecord(line, lineLength);
+}
+
+HexImporter::ErrorCode HexImporter::ImportIntelRecord(const char* line, qint64 lineLength)
+{
     unsigned int byteCount;
     unsigned int lineAddress;
-    unsigned int deviceAddress;
-    unsigned int i;
-    unsigned int endDeviceAddressofRegion;
-    unsigned int bytesPerAddressAndType;
+    const char* payloadText;
+    bool bufferMissing = false;
+    ErrorCode result;
 
-    unsigned char* pPCRAMBuffer = 0;
-    bool importedAtLeastOneByte = false;
+    HEX32_RECORD recordType;
 
-    unsigned char type;
+    unsigned char record[HEX_MAX_RECORD_SIZE];
+    unsigned char* payload = &record[HEX_RECORD_HEADER_SIZE];
+    unsigned char hexLineChecksum;
 
-    HEX32_RECORD recordType;
+    //Do some error checking on the .hex file contents, to make sure the file is
+    //formatted like a legitimate Intel 32-bit formatted .hex file.
+    if ((lineLength < 11) || (lineLength > HEX_MAX_LINE_LENGTH) || (line[0] != ':'))
+    {
+        //Something is wrong if hex line entry, is not minimum length or does not have leading colon (ex: ":BBAAAATTCC")
+        //If an error is detected in the hex file formatting, the safest approach is to
+        //abort the operation and force the user to supply a properly formatted hex file.
+        return ErrorInHexFile;
+    }
 
-    QString hexByte;
-    unsigned int wordByte;
-    hasConfigBits = false;
+    //Extract the info prefix fields from the hex file line data.
+    //Example Intel 32-bit hex file line format is as follows (Note: spaces added to separate fields, actual line does not have spaces in it):
+    //: 10 0100 00 214601360121470136007EFE09D21901 40
+    //Leading ":" is always present on each line from the .hex file.
+    //Next two chars (10) are the byte count of the data payload on this hex file line. (ex: 10 = 0x10 = 16 bytes)
+    //Next four chars (0100) are the 16 bit address (needs to be combined with the extended linear address to generate a 32-bit address).
+    //Next two chars (00) are the "record type".  "00" means it is a "data" record, which means it contains programmable payload data bytes.
+    //Next 2n characters are the data payload bytes (where n is the number of bytes specified in the first two numbers (10 in this example))
+    //Last two characters on the line are the two complement of the byte checksum computed on the other bytes in the line.
+    //For more details on Intel 32-bit hex file formatting see: http://en.wikipedia.org/wiki/Intel_HEX
+    hexLineChecksum = 0;
+    if(!HexDecodePairs(&line[1], record, HEX_RECORD_HEADER_SIZE, &hexLineChecksum))
+    {
+        return ErrorInHexFile;
+    }
+    byteCount = record[0];
+    lineAddress = segmentAddress + ((record[1] << 8) | record[2]);
+    recordType = (HEX32_RECORD)record[3];
 
+    //Error check: Make sure the line contains the number of payload bytes it claims to.
+    if(lineLength < (11 + (2 * byteCount)))
+    {
+        return ErrorInHexFile;
+    }
+    payloadText = &line[1 + (2 * HEX_RECORD_HEADER_SIZE)];
 
-    //Parse the entire hex file, line by line.
-    while (!hexfile.atEnd())
+    if(recordType == DATA)                          // Data Record
     {
-        //Fetch a line of ASCII text from the .hex file.
-        QByteArray line = hexfile.readLine();
+        //Decode the payload straight into the PC RAM buffers.  If the checksum then turns out
+        //to be wrong the buffers hold part of a corrupt record, but the whole import fails so
+        //they are never programmed.
+        result = StoreData(lineAddress, payloadText, byteCount, true, payload, &hexLineChecksum, bufferMissing);
+        if(result != Success)
+        {
+            return result;
+        }
+    }
+    else if(!HexDecodePairs(payloadText, payload, byteCount, &hexLineChecksum))
+    {
+        return ErrorInHexFile;
+    }
 
-        //Do some error checking on the .hex file contents, to make sure the file is
-        //formatted like a legitimate Intel 32-bit formatted .hex file.
-        if ((line[0] != ':') || (line.size() < 11))
+    //Decode the checksum byte itself.
+    if(!HexDecodePairs(&payloadText[2 * byteCount], &payload[byteCount], 1, &hexLineChecksum))
+    {
+        return ErrorInHexFile;
+    }
+
+    //Error check: Verify checksum byte at the end of the .hex file line is valid.  Note,
+    //this is not the same checksum as MPLAB(R) IDE uses/computes for the entire hex file.
+    //This is only the mini-checksum at the end of each line in the .hex file.
+    //The checksum is the two's complement of the sum of the other bytes, so all of them
+    //including the checksum itself add up to zero.  HexDecodePairs() summed them while decoding.
+    if(hexLineChecksum != 0)
+    {
+        //Checksum in the hex file doesn't match the line contents.  This implies a corrupted hex file.
+        //If an error is detected in the hex file formatting, the safest approach is to
+        //abort the operation and force the user to supply a properly formatted hex file.
+        return ErrorInHexFile;
+    }
+
+
+
+    //Check the record type of the hex line, to determine how to continue parsing the data.
+    if (recordType == END_OF_FILE)                        // end of file record
+    {
+        hasEndOfFileRecord = true;
+    }
+    else if ((recordType == EXTENDED_SEGMENT_ADDR) || (recordType == EXTENDED_LINEAR_ADDR)) // Segment address
+    {
+        //Error check: Make sure the line contains the correct number of bytes for the specified record type
+        if(byteCount < 2)
         {
-            //Something is wrong if hex line entry, is not minimum length or does not have leading colon (ex: ":BBAAAATTCC")
+            //Length appears to be wrong in hex line entry.
             //If an error is detected in the hex file formatting, the safest approach is to
             //abort the operation and force the user to supply a properly formatted hex file.
-            if(hexfile.isOpen())
-                hexfile.close();
             return ErrorInHexFile;
         }
 
-        //Extract the info prefix fields from the hex file line data.
-        //Example Intel 32-bit hex file line format is as follows (Note: spaces added to separate fields, actual line does not have spaces in it):
-        //: 10 0100 00 214601360121470136007EFE09D21901 40
-        //Leading ":" is always present on each line from the .hex file.
-        //Next two chars (10) are the byte count of the data payload on this hex file line. (ex: 10 = 0x10 = 16 bytes)
-        //Next four chars (0100) are the 16 bit address (needs to be combined with the extended linear address to generate a 32-bit address).
-        //Next two chars (00) are the "record type".  "00" means it is a "data" record, which means it contains programmable payload data bytes.
-        //Next 2n characters are the data payload bytes (where n is the number of bytes specified in the first two numbers (10 in this example))
-        //Last two characters on the line are the two complement of the byte checksum computed on the other bytes in the line.
-        //For more details on Intel 32-bit hex file formatting see: http://en.wikipedia.org/wiki/Intel_HEX
-        byteCount = line.mid(1, 2).toInt(&ok, 16);                      //Convert the two ASCII chars corresponding to the byte count into a binary encoded byte
-        lineAddress = segmentAddress + line.mid(3, 4).toInt(&ok, 16);   //Convert the four ASCII chars that correspond to the line address into a 16-bit binary encoded word
-        recordType = (HEX32_RECORD)line.mid(7, 2).toInt(&ok, 16);       //Convert the two ASCII chars corresponding to the record type into a binary encoded byte
-
-        //Error check: Verify checksum byte at the end of the .hex file line is valid.  Note,
-        //this is not the same checksum as MPLAB(R) IDE uses/computes for the entire hex file.
-        //This is only the mini-checksum at the end of each line in the .hex file.
-        unsigned int hexLineChecksum = 0;
-        for(i = 0; i < (byteCount+4); i++)  //+4 correction is for byte count, 16-bit address, and record type bytes
-        {
-            hexByte = line.mid(1 + (2 * i), 2); //Fetch two adjacent ASCII bytes from the .hex file
-            wordByte = hexByte.toInt(&ok, 16);  //Re-format the above two ASCII bytes into a single binary encoded byte (0x00-0xFF)
-            //Add the newly fetched byte to the running checksum
-            hexLineChecksum += (unsigned char)wordByte;
-        }
-        //Now get the two's complement of the hexLineChecksum.
-        hexLineChecksum = 0 - hexLineChecksum;
-        hexLineChecksum &= 0xFF;    //Truncate to a single byte.  We now have our computed checksum.  This should match the .hex file.
-        //Fetch checksum byte from the .hex file
-        hexByte = line.mid(1 + (2 * i), 2);     //Fetch the two ASCII bytes that correspond to the checksum byte
-        wordByte = hexByte.toInt(&ok, 16);      //Re-format the above two ASCII bytes into a single binary encoded byte (0x00-0xFF)
-        wordByte &= 0xFF;
-        //Now check if the checksum we computed matches the one at the end of the line in the hex file.
-        if(hexLineChecksum != wordByte)
-        {
-            //Checksum in the hex file doesn't match the line contents.  This implies a corrupted hex file.
-            //If an error is detected in the hex file formatting, the safest approach is to
-            //abort the operation and force the user to supply a properly formatted hex file.
-            if(hexfile.isOpen())
-                hexfile.close();
-            return ErrorInHexFile;
+        //Fetch the payload, which is the upper 4 or 16-bits of the 20-bit or 32-bit hex file address
+        segmentAddress = (payload[0] << 8) | payload[1];
+
+        //Load the upper bits of the address
+        if (recordType == EXTENDED_SEGMENT_ADDR)
+        {
+            segmentAddress <<= 4;
         }
+        else
+        {
+            segmentAddress <<= 16;
+        }
+    } // end if ((recordType == EXTENDED_SEGMENT_ADDR) || (recordType == EXTENDED_LINEAR_ADDR)) // Segment address
+    else if (bufferMissing)
+    {
+        //Previous memory allocation must have failed, or otherwise pDataBuffer would not be = 0.
+        //Since the memory allocation failed, we should bug out and let the user know.
+        return InsufficientMemory;
+    }
 
+    return Success;
+}
 
+//Motorola S-record: 'S', a record type digit, then hex pairs holding the count of the bytes
+//that follow, a 2, 3 or 4 byte address, the data, and a checksum which is the ones' complement
+//of the sum of the count, address and data bytes.  S1/S2/S3 carry data at a linear byte address
+//(the same address space as Intel hex), S7/S8/S9 end the file, S0/S5/S6 are ignored.
+HexImporter::ErrorCode HexImporter::ImportSRecord(const char* line, qint64 lineLength)
+{
+    unsigned char record[256];
+    unsigned char checksum = 0;
+    unsigned int byteCount;
+    unsigned int addressLength;
+    unsigned int dataCount;
+    unsigned int address = 0;
+    unsigned int i;
+    const char* dataText;
+    bool bufferMissing = false;
+    ErrorCode result;
+
+    if((lineLength < 4) || (lineLength > HEX_MAX_LINE_LENGTH))
+    {
+        return ErrorInHexFile;
+    }
+
+    switch(line[1])
+    {
+        case '0': case '1': case '5': case '9':
+            addressLength = 2;
+            break;
+        case '2': case '6': case '8':
+            addressLength = 3;
+            break;
+        case '3': case '7':
+            addressLength = 4;
+            break;
+        default:
+            return ErrorInHexFile;
+    }
+
+    if(!HexDecodePairs(&line[2], record, 1, &checksum))
+    {
+        return ErrorInHexFile;
+    }
+    byteCount = record[0];
+    if((byteCount < (addressLength + 1)) || (lineLength < (4 + (2 * byteCount))))
+    {
+        return ErrorInHexFile;
+    }
+    if(!HexDecodePairs(&line[4], &record[1], addressLength, &checksum))
+    {
+        return ErrorInHexFile;
+    }
+    for(i = 0; i < addressLength; i++)
+    {
+        address = (address << 8) | record[1 + i];
+    }
 
-        //Check the record type of the hex line, to determine how to continue parsing the data.
-        if (recordType == END_OF_FILE)                        // end of file record
+    dataCount = byteCount - addressLength - 1;
+    dataText = &line[4 + (2 * addressLength)];
+    if((line[1] >= '1') && (line[1] <= '3'))
+    {
+        result = StoreData(address, dataText, dataCount, true, &record[1 + addressLength], &checksum, bufferMissing);
+        if(result != Success)
         {
-            hasEndOfFileRecord = true;
+            return result;
+        }
+    }
+    else if(!HexDecodePairs(dataText, &record[1 + addressLength], dataCount, &checksum))
+    {
+        return ErrorInHexFile;
+    }
+
+    if(!HexDecodePairs(&dataText[2 * dataCount], &record[byteCount], 1, &checksum) || (checksum != 0xFF))
+    {
+        return ErrorInHexFile;
+    }
+
+    if((line[1] >= '7') && (line[1] <= '9'))
+    {
+        hasEndOfFileRecord = true;
+    }
+    else if(bufferMissing)
+    {
+        return InsufficientMemory;
+    }
+
+    return Success;
+}
+
+//Raw binary images carry no addresses, so the bytes are stored at consecutive .hex file
+//addresses from address on.
+HexImporter::ErrorCode HexImporter::ImportBinary(const char* data, qint64 length, quint64 address)
+{
+    bool bufferMissing = false;
+
+    StoreData(address, data, length, false, 0, 0, bufferMissing);
+    return bufferMissing ? InsufficientMemory : Success;
+}
+
+//Returns true if data starts with an ELF identification.
+bool HexImporter::IsElf(const char* data, qint64 length)
+{
+    return (data != 0) && (length >= 4) && (memcmp(data, "\x7F" "ELF", 4) == 0);
+}
+
+//Reads a 16 or 32-bit ELF header field in the file's own byte order.
+static quint32 ElfField(const unsigned char* field, int size, bool bigEndian)
+{
+    quint32 value = 0;
+    int i;
+
+    for(i = 0; i < size; i++)
+    {
+        value |= (quint32)field[bigEndian ? (size - 1 - i) : i] << (8 * i);
+    }
+    return value;
+}
+
+//Imports an ELF32 executable, as produced by the compiler for the device's family; any other
+//e_machine is refused.  The file contents of every PT_LOAD segment are stored from the segment's
+//physical (load) address on.  That is a device address, so on word addressed families it is
+//scaled by the bytes per address to the .hex file address the segment gets in a .hex file
+//converted from the same ELF file.  The zero filled tail of a segment (p_memsz beyond p_filesz,
+//i.e. .bss) is RAM and is not programmed.
+HexImporter::ErrorCode HexImporter::ImportElf(const char* data, qint64 length, Device* device)
+{
+    const unsigned char* header = (const unsigned char*)data;
+    const unsigned char* programHeader;
+    quint32 machine;
+    quint32 bytesPerAddress = device->GetBytesPerAddress(PROGRAM_MEMORY);
+    quint32 tableOffset;
+    quint32 entrySize;
+    quint32 entryCount;
+    quint32 offset;
+    quint32 fileSize;
+    bool bigEndian;
+    bool bufferMissing = false;
+    quint32 i;
+
+    if((length < ELF_HEADER_SIZE) || (header[ELF_CLASS] != ELF_CLASS_32) ||
+       ((header[ELF_DATA] != ELF_DATA_LSB) && (header[ELF_DATA] != ELF_DATA_MSB)))
+    {
+        return ErrorInHexFile;
+    }
+    bigEndian = (header[ELF_DATA] == ELF_DATA_MSB);
+
+    machine = ElfField(&header[ELF_MACHINE], 2, bigEndian);
+    switch(device->family)
+    {
+        case Device::PIC16:
+        case Device::PIC18:
+            if(machine != ELF_EM_MCHP_PIC)
+                return ErrorInHexFile;
+            break;
+        case Device::PIC24:
+            if(machine != ELF_EM_DSPIC30F)
+                return ErrorInHexFile;
+            break;
+        case Device::PIC32:
+            if(machine != ELF_EM_MIPS)
+                return ErrorInHexFile;
             break;
+        default:
+            return ErrorInHexFile;
+    }
+
+    tableOffset = ElfField(&header[ELF_PHOFF], 4, bigEndian);
+    entrySize = ElfField(&header[ELF_PHENTSIZE], 2, bigEndian);
+    entryCount = ElfField(&header[ELF_PHNUM], 2, bigEndian);
+    if((entrySize < ELF_PROGRAM_HEADER_SIZE) ||
+       ((quint64)tableOffset + (quint64)entrySize * entryCount > (quint64)length))
+    {
+        return ErrorInHexFile;
+    }
+
+    for(i = 0; i < entryCount; i++)
+    {
+        programHeader = &header[tableOffset + i * entrySize];
+        if(ElfField(&programHeader[ELF_P_TYPE], 4, bigEndian) != ELF_PT_LOAD)
+        {
+            continue;
         }
-        else if ((recordType == EXTENDED_SEGMENT_ADDR) || (recordType == EXTENDED_LINEAR_ADDR)) // Segment address
+
+        offset = ElfField(&programHeader[ELF_P_OFFSET], 4, bigEndian);
+        fileSize = ElfField(&programHeader[ELF_P_FILESZ], 4, bigEndian);
+        if((quint64)offset + fileSize > (quint64)length)
         {
-            //Error check: Make sure the line contains the correct number of bytes for the specified record type
-            if((unsigned int)line.size() >= (11 + (2 * byteCount)))
-            {
-                //Fetch the payload, which is the upper 4 or 16-bits of the 20-bit or 32-bit hex file address
-                segmentAddress = line.mid(9, 4).toInt(&ok, 16);
+            return ErrorInHexFile;
+        }
+
+        StoreData((quint64)ElfField(&programHeader[ELF_P_PADDR], 4, bigEndian) * bytesPerAddress, &data[offset], fileSize,
+                  false, 0, 0, bufferMissing);
+    }
+
+    return bufferMissing ? InsufficientMemory : Success;
+}
+
+//Reads a raw binary image from a file that cannot be mapped, such as a pipe.
+HexImporter::ErrorCode HexImporter::ImportStreamedBinary(QIODevice& file)
+{
+    char block[HEX_BINARY_BLOCK_SIZE];
+    quint64 address = binaryBaseAddress;
+    qint64 length;
+    ErrorCode result;
+
+    while((length = file.read(block, sizeof(block))) > 0)
+    {
+        result = ImportBinary(block, length, address);
+        if(result != Success)
+        {
+            return result;
+        }
+        address += length;
+    }
+
+    return Success;
+}
+
+//Stores count data bytes that belong at consecutive .hex file addresses from address on.  The
+//data is split where it crosses programmable region boundaries, and each piece that lands
+//inside a region goes straight into that region's PC RAM buffer.  Bytes outside every region are
+//discarded.
+//With hexText, source holds ASCII hex pairs which are decoded on the way and summed into
+//*checksum; pieces outside every region are decoded into scratch (count bytes) only so they
+//count towards the checksum.  Invalid characters are caught in the same pass.  Otherwise source
+//holds binary bytes which are copied as they are.
+//A region without a buffer sets bufferMissing, for the caller to report once the record is known
+//to be valid.
+HexImporter::ErrorCode HexImporter::StoreData(quint64 address, const char* source, quint64 count, bool hexText, unsigned char* scratch, unsigned char* checksum, bool& bufferMissing)
+{
+    const HexAddressIndex::Region* region;
+    unsigned char* destination;
+    quint64 span;
+    quint64 i = 0;
 
-                //Load the upper bits of the address
-                if (recordType == EXTENDED_SEGMENT_ADDR)
+    while(i < count)
+    {
+        region = addressIndex.Find(address);
+        if((region == 0) || (address < region->hexStart))
+        {
+            span = (region == 0) ? (count - i) : qMin(region->hexStart - address, count - i);
+            destination = hexText ? &scratch[i] : 0;
+        }
+        else
+        {
+            span = qMin(region->hexEnd - address, count - i);
+            if(region->pDataBuffer != 0)
+            {
+                destination = region->pDataBuffer + (address - region->hexStart);
+                importedAtLeastOneByte = true;       //Set flag so we know we imported something successfully.
+                if(recordWrites)
                 {
-                    segmentAddress <<= 4;
+                    RecordWrite(address, span);
                 }
-                else
+
+                //Check if we just stored config bit bytes.  If so, set flag so the user is no longer locked out
+                //of programming the config bits section.
+                if(region->type == CONFIG_MEMORY)
                 {
-                    segmentAddress <<= 16;
+                    hasConfigBits = true;
                 }
-
-                //Update the line address, now that we know the upper bits are something new.
-                lineAddress = segmentAddress + line.mid(3, 4).toInt(&ok, 16);
             }
             else
             {
-                //Length appears to be wrong in hex line entry.
-                //If an error is detected in the hex file formatting, the safest approach is to
-                //abort the operation and force the user to supply a properly formatted hex file.
-                if(hexfile.isOpen())
-                    hexfile.close();
-                return ErrorInHexFile;
+                destination = hexText ? &scratch[i] : 0;
+                bufferMissing = true;
             }
+        }
 
-        } // end if ((recordType == EXTENDED_SEGMENT_ADDR) || (recordType == EXTENDED_LINEAR_ADDR)) // Segment address
-        else if (recordType == DATA)                        // Data Record
+        if(hexText)
         {
-            //Error check to make sure line is long enough to be consistent with the specified record type
-            if ((unsigned int)line.size() < (11 + (2 * byteCount)))
+            if(!HexDecodePairs(&source[2 * i], destination, span, checksum))
             {
-                //If an error is detected in the hex file formatting, the safest approach is to
-                //abort the operation and force the user to supply a proper hex file.
-                if(hexfile.isOpen())
-                    hexfile.close();
                 return ErrorInHexFile;
             }
-
-
-            //For each data payload byte we find in the hex file line, check if it is contained within
-            //a progammable region inside the microcontroller.  If so save it.  If not, discard it.
-            for(i = 0; i < byteCount; i++)
-            {
-                //Use the hex file linear byte address, to compute other imformation about the
-                //byte/location.  The GetDeviceAddressFromHexAddress() function gives us a pointer to
-                //the PC RAM buffer byte that will get programmed into the microcontroller, which corresponds
-                //to the specified .hex file extended address.
-                //The function also returns a boolean letting us know if the address is part of a programmable memory region on the device.
-                deviceAddress = device->GetDeviceAddressFromHexAddress(lineAddress + i, pData, type, includedInProgrammableRange, addressWasEndofRange, bytesPerAddressAndType, endDeviceAddressofRegion, pPCRAMBuffer);
-                //Check if the just parsed hex byte was included in one of the microcontroller reported programmable memory regions.
-                //If so, save the byte into the proper location in the PC RAM buffer, so it can be programmed later.
-                if((includedInProgrammableRange == true) && (pPCRAMBuffer != 0)) //Make sure pPCRAMBuffer pointer is valid before using it.
-                {
-                    //Print debug output text to debug window
-                    if(i == 0)
-                    {
-                        //qDebug(QString("Importing .hex file line with device address: 0x" + QString::number(deviceAddress, 16)).toLatin1());
-                    }
-
-                    //Fetch ASCII encoded payload byte from .hex file and save the byte to our temporary RAM buffer.
-                    hexByte = line.mid(9 + (2 * i), 2);  //Fetch two ASCII data payload bytes from the .hex file
-                    wordByte = hexByte.toInt(&ok, 16);   //Re-format the above two ASCII bytes into a single binary encoded byte (0x00-0xFF)
-
-                    *pPCRAMBuffer = (unsigned char)wordByte;    //Save the .hex file data byte into the PC RAM buffer that holds the data to be programmed
-                    importedAtLeastOneByte = true;       //Set flag so we know we imported something successfully.
-
-                    //Check if we just parsed a config bit byte.  If so, set flag so the user is no longer locked out
-                    //of programming the config bits section.
-                    if(type == CONFIG_MEMORY)
-                    {
-                        hasConfigBits = true;
-                    }
-                }
-                else if((includedInProgrammableRange == true) && (pPCRAMBuffer == 0))
-                {
-                    //Previous memory allocation must have failed, or otherwise pPCRAMBuffer would not be = 0.
-                    //Since the memory allocation failed, we should bug out and let the user know.
-                    if(hexfile.isOpen())
-                        hexfile.close();
-                    return InsufficientMemory;
-                }
-            }//for(i = 0; i < byteCount; i++)
-        } // end else if (recordType == DATA)
-    }//while (!hexfile.atEnd())
-
-    //If we get to here, that means we reached the end of the hex file, or we found a END_OF_FILE record in the .hex file.
-    if(hexfile.isOpen())
-    {
-        hexfile.close();
+        }
+        else if(destination != 0)
+        {
+            memcpy(destination, &source[i], span);
+        }
+        i += span;
+        address += span;
     }
 
-    //Check if we imported any data from the .hex file.
-    if(importedAtLeastOneByte == true)
+    return Success;
+}
+
+//Remembers that [address, address + length) was written, extending the previous span when
+//the records are contiguous, as they nearly always are.
+void HexImporter::RecordWrite(quint64 address, quint64 length)
+{
+    if(!writtenSpans.isEmpty() && (writtenSpans.last().end == address))
     {
-        //qDebug(QString("Hex File imported successfully.").toLatin1());
-        return Success;
+        writtenSpans.last().end += length;
     }
     else
     {
-        //If we get to here, we didn't import anything.  The hex file must have been empty or otherwise didn't
-        //contain any data that overlaps a device programmable region.  We should let the user know they should
-        //supply a better hex file designed for their device.
-        return NoneInRange;
+        WrittenSpan span;
+        span.start = address;
+        span.end = address + length;
+        writtenSpans.append(span);
     }
 }
 
+//Records the .hex file addresses this import wrote as extents of the ranges they landed in, so
+//later stages can skip the parts of each range the file left blank.
+void HexImporter::StoreExtents(DeviceData* pData, Device* device)
+{
+    unsigned int bytesPerAddress;
+    quint64 start;
+    quint64 end;
 
+    MergeSpans(writtenSpans);
+    foreach(WrittenSpan span, writtenSpans)
+    {
+        foreach(HexAddressIndex::Region region, addressIndex.regions)
+        {
+            start = qMax(span.start, region.hexStart);
+            end = qMin(span.end, region.hexEnd);
+            if(start >= end)
+            {
+                continue;
+            }
 
-
-
+            DeviceData::MemoryRange& range = pData->ranges[region.range];
+            bytesPerAddress = device->GetBytesPerAddress(range.type);
+            DeviceData::AddExtent(range, start / bytesPerAddress, (end + bytesPerAddress - 1) / bytesPerAddress);
+        }
+    }
+}
@@ -27,11 +27,13 @@
 #define IMPORTEXPORTHEX_H
 
 #include <QString>
+#include <QIODevice>
 #include "DeviceData.h"
 #include "Device.h"
 
 /*!
- * Reads HEX files into an in-memory DeviceData object.
+ * Reads Intel HEX, Motorola S-record, ELF32 and raw binary files, and firmware bundles,
+ * into an in-memory DeviceData object.
  */
 class HexImporter
 {
@@ -46,6 +48,33 @@ public:
         EXTENDED_LINEAR_ADDR = 0x04,
     };
 
+    //ELF32 header and program header field offsets, and the values the loader accepts.
+    enum ELF32_LAYOUT
+    {
+        ELF_CLASS = 4,                  //e_ident[EI_CLASS]
+        ELF_DATA = 5,                   //e_ident[EI_DATA]
+        ELF_MACHINE = 18,
+        ELF_PHOFF = 28,
+        ELF_PHENTSIZE = 42,
+        ELF_PHNUM = 44,
+        ELF_HEADER_SIZE = 52,
+
+        ELF_P_TYPE = 0,
+        ELF_P_OFFSET = 4,
+        ELF_P_PADDR = 12,
+        ELF_P_FILESZ = 16,
+        ELF_PROGRAM_HEADER_SIZE = 32,
+
+        ELF_CLASS_32 = 1,
+        ELF_DATA_LSB = 1,
+        ELF_DATA_MSB = 2,
+        ELF_PT_LOAD = 1,
+
+        ELF_EM_MIPS = 8,                //PIC32
+        ELF_EM_DSPIC30F = 118,          //PIC24 and dsPIC
+        ELF_EM_MCHP_PIC = 204,          //8-bit PIC
+    };
+
     //Definitions for the program memory "word write" size for different microcontroller families
     enum PROG_WORD_WRITE_SIZE
     {
@@ -67,10 +96,46 @@ public:
 
     QList<DeviceData::MemoryRange> rawimport;
 
+    //Raw binary images carry no addresses.  Files named *.bin, or any file with forceBinary set,
+    //are stored from this .hex file address on.
+    unsigned int binaryBaseAddress;
+    bool forceBinary;
+
+    //A run of .hex file addresses written by the import.
+    struct WrittenSpan
+    {
+        quint64 start;
+        quint64 end;
+    };
+
 
 protected:
     //int ParseHex(char* characters, int length);
     //unsigned char computeChecksum(char* fileLine);
+    ErrorCode ImportMappedFile(const char* data, qint64 length);
+    ErrorCode ImportMappedRecords(const char* data, qint64 length);
+    ErrorCode ImportStreamedRecords(QIODevice& file);
+    ErrorCode ImportRecord(const char* line, qint64 lineLength);
+    ErrorCode ImportIntelRecord(const char* line, qint64 lineLength);
+    ErrorCode ImportSRecord(const char* line, qint64 lineLength);
+    ErrorCode ImportBinary(const char* data, qint64 length, quint64 address);
+    ErrorCode ImportStreamedBinary(QIODevice& file);
+    static bool IsElf(const char* data, qint64 length);
+    ErrorCode ImportElf(const char* data, qint64 length, Device* device);
+    ErrorCode StoreData(quint64 address, const char* source, quint64 count, bool hexText, unsigned char* scratch, unsigned char* checksum, bool& bufferMissing);
+
+    void RecordWrite(quint64 address, quint64 length);
+    void StoreExtents(DeviceData* pData, Device* device);
+
+    HexAddressIndex addressIndex;   // where each .hex file address lands, built per import
+
+    bool recordWrites;              // collect writtenSpans
+    QVector<WrittenSpan> writtenSpans;
+
+    friend class HexChunkWorker;
+
+    unsigned int segmentAddress;    // upper address bits from the last type 02 or 04 record
+    bool importedAtLeastOneByte;
 
 
 };
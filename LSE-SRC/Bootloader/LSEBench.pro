@@ -0,0 +1,18 @@
+TARGET = "LSEBench"
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS_RELEASE = -O2
+INCLUDEPATH += ../
+include(Core.pri)
+SOURCES += \
+    Benchmark.cpp
+
+#-------------------------------------------------
+# Only meaningful against the simulator, so it is
+# only built with CONFIG+=hidsim (see HIDBootloader.pro)
+#-------------------------------------------------
+DESTDIR = sim
+OBJECTS_DIR = sim/bench
+MOC_DIR = sim/bench
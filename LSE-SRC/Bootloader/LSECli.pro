@@ -0,0 +1,30 @@
+TARGET = "LSECli"
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS_RELEASE = -Os
+INCLUDEPATH += ../
+include(Core.pri)
+SOURCES += \
+    CommandLine.cpp
+
+#-------------------------------------------------
+# Same output directory as the GUI, but keep the
+# object files apart
+#-------------------------------------------------
+macx {
+    DESTDIR = mac
+    OBJECTS_DIR = mac/cli
+    MOC_DIR = mac/cli
+}
+unix: !macx {
+    DESTDIR = linux
+    OBJECTS_DIR = linux/cli
+    MOC_DIR = linux/cli
+}
+win32 {
+    DESTDIR = windows
+    OBJECTS_DIR = windows/cli
+    MOC_DIR = windows/cli
+}
@@ -0,0 +1,19 @@
+TARGET = "LSESimTests"
+TEMPLATE = app
+QT -= gui
+QT += testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+INCLUDEPATH += ../
+include(Core.pri)
+SOURCES += \
+    tests/SimTests.cpp
+
+#-------------------------------------------------
+# Programs the simulator end to end, so it is only
+# built with CONFIG+=hidsim (see HIDBootloader.pro).
+# Run with "make check"
+#-------------------------------------------------
+DESTDIR = sim
+OBJECTS_DIR = sim/tests
+MOC_DIR = sim/tests
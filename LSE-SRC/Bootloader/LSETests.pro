@@ -0,0 +1,31 @@
+TARGET = "LSETests"
+TEMPLATE = app
+QT -= gui
+QT += testlib
+CONFIG += console testcase
+CONFIG -= app_bundle
+INCLUDEPATH += ../
+include(Core.pri)
+SOURCES += \
+    tests/CoreTests.cpp
+
+#-------------------------------------------------
+# Unit tests for the core, run with "make check".
+# Same output directory as the GUI, but keep the
+# object files apart
+#-------------------------------------------------
+macx {
+    DESTDIR = mac
+    OBJECTS_DIR = mac/tests
+    MOC_DIR = mac/tests
+}
+unix: !macx {
+    DESTDIR = linux
+    OBJECTS_DIR = linux/tests
+    MOC_DIR = linux/tests
+}
+win32 {
+    DESTDIR = windows
+    OBJECTS_DIR = windows/tests
+    MOC_DIR = windows/tests
+}
@@ -39,6 +39,7 @@
 #include "DeviceData.h"
 #include "Device.h"
 #include "ImportExportHex.h"
+#include "Programmer.h"
 
 namespace Ui
 {
@@ -94,6 +95,7 @@ protected:
     DeviceData* deviceData;
     DeviceData* hexData;
     Device* device;
+    Programmer* programmer;
 
     QFuture<void> future;
 
@@ -105,9 +107,11 @@ protected:
     bool writeEeprom;
     bool writeConfig;
     bool eraseDuringWrite;
+    bool deltaWrite;
     bool hexOpen;
 
     void setBootloadEnabled(bool enable);
+    void SyncWriteOptions(void);
 
     void UpdateRecentFileList(void);
 
@@ -0,0 +1,1322 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <QTime>
+
+#include "Programmer.h"
+#include "FirmwareBundle.h"
+#include "VerifyCompare.h"
+
+//Surely the micro doesn't have a programmable memory region greater than 268 Megabytes...
+//Value used for error checking device reponse values.
+#define MAXIMUM_PROGRAMMABLE_MEMORY_SEGMENT_SIZE 0x0FFFFFFF
+
+//How many of the mismatches found by a verify or blank check are written to the log one by one.
+#define MAX_LOGGED_MISMATCHES 16
+
+/*!
+ * Compares each GET_DATA reply against the hex data while the rest of the region
+ * is still being read, and stops the read at the first packet that really differs.
+ */
+class StreamCompare : public Comm::PacketSink
+{
+public:
+    StreamCompare(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask)
+    {
+        this->actual = actual;
+        this->expected = expected;
+        this->careMask = careMask;
+        base = 0;
+        failed = false;
+        failedOffset = 0;
+        failedLength = 0;
+    }
+
+    bool PacketReceived(uint32_t offset, uint32_t length)
+    {
+        offset += base;
+        if(VerifyCompare(actual + offset, expected + offset, careMask ? (careMask + offset) : 0, length, NULL) == 0)
+        {
+            return true;
+        }
+        failed = true;
+        failedOffset = offset;
+        failedLength = length;
+        return false;
+    }
+
+    uint32_t base;              // buffer offset of the current GetData() call's first byte
+    bool failed;
+    uint32_t failedOffset;
+    uint32_t failedLength;
+
+protected:
+    const unsigned char* actual;
+    const unsigned char* expected;
+    const unsigned char* careMask;
+};
+
+//Returns the CRC the bootloader reports for an erased flash page of pageSize bytes.
+static uint16_t BlankPageCrc(uint32_t pageSize)
+{
+    unsigned char blank[64];
+    uint16_t crc = 0xFFFF;
+    uint32_t chunk;
+
+    memset(blank, 0xFF, sizeof(blank));
+    while(pageSize > 0)
+    {
+        chunk = qMin(pageSize, (uint32_t)sizeof(blank));
+        crc = FirmwareBundle::Crc16(blank, chunk, crc);
+        pageSize -= chunk;
+    }
+    return crc;
+}
+
+Programmer::Programmer(Comm* comm, Device* device, DeviceData* deviceData, QObject *parent) :
+    QObject(parent)
+{
+    this->comm = comm;
+    this->device = device;
+    this->deviceData = deviceData;
+
+    writeFlash = true;
+    writeEeprom = true;
+    writeConfig = false;
+    crcVerify = true;
+    deltaWrite = false;
+    pageCrcUnsupported = false;
+
+    deviceFirmwareIsAtLeast101 = false;
+    memset((void*)&extendedBootInfo, 0x00, sizeof(extendedBootInfo));
+}
+
+//Releases the RAM buffers of every range in data and empties the range list.
+void Programmer::FreeRanges(DeviceData* data)
+{
+    foreach(DeviceData::MemoryRange range, data->ranges)
+    {
+        delete [] range.pDataBuffer;
+    }
+    data->ranges.clear();
+    data->pageCrcs.clear();
+    data->pageCrcSize = 0;
+}
+
+//Returns the flash erase page size the bootloader reported in the extended query info, or 0 if it
+//didn't report one.
+unsigned int Programmer::ErasePageSize(void)
+{
+    if(!deviceFirmwareIsAtLeast101 || (device->family != Device::PIC18))
+    {
+        return 0;
+    }
+    return extendedBootInfo.PIC18.erasePageSize;
+}
+
+//Returns the CRC of the pageSize bytes of hex data at data, for the erase page at address.  Taken
+//from hexData when it came from a firmware bundle with the page CRCs precomputed.
+uint16_t Programmer::HexPageCrc(const DeviceData* hexData, const unsigned char* data, uint32_t address, uint32_t pageSize)
+{
+    if((hexData != 0) && (hexData->pageCrcSize == pageSize) && hexData->pageCrcs.contains(address))
+    {
+        return hexData->pageCrcs.value(address);
+    }
+    return FirmwareBundle::Crc16(data, pageSize);
+}
+
+//Sends the QUERY_DEVICE command and rebuilds the device parameters and the list of programmable
+//regions (deviceData) from the response.  On v1.01 or newer bootloaders the extended query info
+//is fetched as well.
+Comm::ErrorCode Programmer::Query(void)
+{
+    Comm::BootInfo bootInfo;
+    Comm::ErrorCode result;
+    DeviceData::MemoryRange range;
+
+    qDebug("Executing Query() command.");
+
+    if(!comm->isConnected())
+    {
+        qWarning("Query not sent, device not connected");
+        return Comm::NotConnected;
+    }
+
+    //Send the Query command to the device over USB, and check the result status.
+    result = comm->ReadBootloaderInfo(&bootInfo);
+    switch(result)
+    {
+        case Comm::Success:
+        case Comm::Timeout:
+            break;
+        default:
+            return result;
+    }
+
+    FreeRanges(deviceData);
+    pageCrcUnsupported = false;
+
+    //Now start parsing the bootInfo packet to learn more about the device.  The bootInfo packet contains
+    //contains the query response data from the USB device.  We will save these values into member variables
+    //so other parts of the application can use the info when deciding how to do things.
+    device->family = (Device::Families) bootInfo.deviceFamily;
+    device->bytesPerPacket = bootInfo.bytesPerPacket;
+
+    //Set some processor family specific variables that will be used elsewhere (ex: during program/verify operations).
+    switch(device->family)
+    {
+        case Device::PIC18:
+            device->bytesPerWordFLASH = 2;
+            device->bytesPerAddressFLASH = 1;
+            break;
+        case Device::PIC24:
+            device->bytesPerWordFLASH = 4;
+            device->bytesPerAddressFLASH = 2;
+            device->bytesPerWordConfig = 4;
+            device->bytesPerAddressConfig = 2;
+            break;
+        case Device::PIC32:
+            device->bytesPerWordFLASH = 4;
+            device->bytesPerAddressFLASH = 1;
+            break;
+        case Device::PIC16:
+            device->bytesPerWordFLASH = 2;
+            device->bytesPerAddressFLASH = 2;
+        default:
+            device->bytesPerWordFLASH = 2;
+            device->bytesPerAddressFLASH = 1;
+            break;
+    }
+
+    //Initialize the deviceData buffers and length variables, with the regions that the firmware claims are
+    //reprogrammable.  We will need this information later, to decide what part(s) of the .hex file we
+    //should look at/try to program into the device.  Data sections in the .hex file that are not included
+    //in these regions should be ignored.
+    for(int i = 0; i < MAX_DATA_REGIONS; i++)
+    {
+        if(bootInfo.memoryRegions[i].type == END_OF_TYPES_LIST)
+        {
+            //Before we quit, check the special versionFlag byte,
+            //to see if the bootloader firmware is at least version 1.01.
+            //If it is, then it will support the extended query command.
+            //If the device is based on v1.00 bootloader firmware, it will have
+            //loaded the versionFlag location with 0x00, which was a pad byte.
+            if(bootInfo.versionFlag == BOOTLOADER_V1_01_OR_NEWER_FLAG)
+            {
+                deviceFirmwareIsAtLeast101 = true;
+                qDebug("Device bootloader firmware is v1.01 or newer and supports Extended Query.");
+                //Now fetch the extended query information packet from the USB firmware.
+                comm->ReadExtendedQueryInfo(&extendedBootInfo);
+                qDebug("Device bootloader firmware version is: 0x%x", extendedBootInfo.PIC18.bootloaderVersion);
+            }
+            else
+            {
+                deviceFirmwareIsAtLeast101 = false;
+            }
+            break;
+        }
+
+        //Error check: Check the firmware's reported size to make sure it is sensible.  This ensures
+        //we don't try to allocate ourselves a massive amount of RAM (capable of crashing this PC app)
+        //if the firmware claimed an improper value.
+        if(bootInfo.memoryRegions[i].size > MAXIMUM_PROGRAMMABLE_MEMORY_SEGMENT_SIZE)
+        {
+            bootInfo.memoryRegions[i].size = MAXIMUM_PROGRAMMABLE_MEMORY_SEGMENT_SIZE;
+        }
+
+        //Parse the bootInfo response packet and allocate ourselves some RAM to hold the eventual data to program.
+        if(bootInfo.memoryRegions[i].type == PROGRAM_MEMORY)
+        {
+            range.type = PROGRAM_MEMORY;
+            range.dataBufferLength = bootInfo.memoryRegions[i].size * device->bytesPerAddressFLASH;
+            range.pDataBuffer = new unsigned char[range.dataBufferLength];
+            memset(&range.pDataBuffer[0], 0xFF, range.dataBufferLength);
+        }
+        else if(bootInfo.memoryRegions[i].type == EEPROM_MEMORY)
+        {
+            range.type = EEPROM_MEMORY;
+            range.dataBufferLength = bootInfo.memoryRegions[i].size * device->bytesPerAddressEEPROM;
+            range.pDataBuffer = new unsigned char[range.dataBufferLength];
+            memset(&range.pDataBuffer[0], 0xFF, range.dataBufferLength);
+        }
+        else if(bootInfo.memoryRegions[i].type == CONFIG_MEMORY)
+        {
+            range.type = CONFIG_MEMORY;
+            range.dataBufferLength = bootInfo.memoryRegions[i].size * device->bytesPerAddressConfig;
+            range.pDataBuffer = new unsigned char[range.dataBufferLength];
+            memset(&range.pDataBuffer[0], 0xFF, range.dataBufferLength);
+        }
+
+        //Notes regarding range.start and range.end: The range.start is defined as the starting address inside
+        //the USB device that will get programmed.  For example, if the bootloader occupies 0x000-0xFFF flash
+        //memory addresses (ex: on a PIC18), then the starting bootloader programmable address would typically
+        //be = 0x1000 (ex: range.start = 0x1000).
+        //The range.end is defined as the last address that actually gets programmed, plus one, in this programmable
+        //region.  For example, for a 64kB PIC18 microcontroller, the last implemented flash memory address
+        //is 0xFFFF.  If the last 1024 bytes are reserved by the bootloader (since that last page contains the config
+        //bits for instance), then the bootloader firmware may only allow the last address to be programmed to
+        //be = 0xFBFF.  In this scenario, the range.end value would be = 0xFBFF + 1 = 0xFC00.
+        //When this application uses the range.end value, it should be aware that the actual address limit of
+        //range.end does not actually get programmed into the device, but the address just below it does.
+        //In this example, the programmed region would end up being 0x1000-0xFBFF (even though range.end = 0xFC00).
+        //The proper code to program this would basically be something like this:
+        //for(i = range.start; i < range.end; i++)
+        //{
+        //    //Insert code here that progams one device address.  Note: for PIC18 this will be one byte for flash memory.
+        //    //For PIC24 this is actually 2 bytes, since the flash memory is addressed as a 16-bit word array.
+        //}
+        //In the above example, the for() loop exits just before the actual range.end value itself is programmed.
+
+        range.start = bootInfo.memoryRegions[i].address;
+        range.end = bootInfo.memoryRegions[i].address + bootInfo.memoryRegions[i].size;
+        //Add the new structure+buffer to the list
+        deviceData->ranges.append(range);
+    }
+
+    return result;
+}
+
+//Duplicates the programmable region list reported by Query() into hexData, with freshly allocated
+//0xFF filled buffers, and imports the hex file into them.
+HexImporter::ErrorCode Programmer::ImportHexFile(QString fileName, DeviceData* hexData, HexImporter& import)
+{
+    FreeRanges(hexData);
+
+    foreach(DeviceData::MemoryRange range, deviceData->ranges)
+    {
+        //Allocate some RAM for the hex file data we are about to import.
+        //Initialize all bytes of the buffer to 0xFF, the default unprogrammed memory value,
+        //which is also the "assumed" value, if a value is missing inside the .hex file, but
+        //is still included in a programmable memory region.
+        range.pDataBuffer = new unsigned char[range.dataBufferLength];
+        memset(range.pDataBuffer, 0xFF, range.dataBufferLength);
+        hexData->ranges.append(range);
+    }
+
+    //Import the hex file data into the hexData->ranges[].pDataBuffer buffers.
+    return import.ImportHexFile(fileName, hexData, device);
+}
+
+Comm::ErrorCode Programmer::Erase(void)
+{
+    QTime elapsed;
+    Comm::ErrorCode result;
+    Comm::BootInfo bootInfo;
+
+    emit IoWithDeviceStarted("Erasing Device... (no status update until complete, may take several seconds)");
+    elapsed.start();
+
+    result = comm->Erase();
+    if(result != Comm::Success)
+    {
+        emit IoWithDeviceCompleted("Erase", result, ((double)elapsed.elapsed()) / 1000);
+        return result;
+    }
+
+    result = comm->ReadBootloaderInfo(&bootInfo);
+
+    emit IoWithDeviceCompleted("Erase", result, ((double)elapsed.elapsed()) / 1000);
+    return result;
+}
+
+//Programs previously parsed .hex file data into the device's programmable memory regions.
+//The device should already have been erased.
+Comm::ErrorCode Programmer::Program(DeviceData* hexData)
+{
+    QTime elapsed;
+    Comm::ErrorCode result = Comm::Success;
+    DeviceData::MemoryRange hexRange;
+
+    emit IoWithDeviceStarted("Writing Device...");
+    foreach(hexRange, hexData->ranges)
+    {
+        if((writeFlash && (hexRange.type == PROGRAM_MEMORY)) ||
+           (writeEeprom && (hexRange.type == EEPROM_MEMORY)) ||
+           (writeConfig && (hexRange.type == CONFIG_MEMORY)))
+        {
+            elapsed.start();
+
+            //The erase has already left flash blank, so only the parts the hex file filled in are sent.
+            //EEPROM and config bits are written in full, 0xFF and all.
+            if(hexRange.type == PROGRAM_MEMORY)
+            {
+                result = ProgramExtents(hexRange);
+            }
+            else
+            {
+                result = ProgramRange(hexRange.type, hexRange.start, hexRange.end, hexRange.pDataBuffer);
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        if(result != Comm::Success)
+        {
+            qWarning("Programming failed");
+            return result;
+        }
+    }
+
+    emit IoWithDeviceCompleted("Write", result, ((double)elapsed.elapsed()) / 1000);
+    return result;
+}
+
+//Programs data, the hex data for device addresses [start, end) of a region of the given type.
+Comm::ErrorCode Programmer::ProgramRange(unsigned char type, uint32_t start, uint32_t end, unsigned char* data)
+{
+    switch(type)
+    {
+        case PROGRAM_MEMORY:
+            return comm->Program(start, device->bytesPerPacket, device->bytesPerAddressFLASH,
+                                 device->bytesPerWordFLASH, device->family, end, data);
+        case EEPROM_MEMORY:
+            return comm->Program(start, device->bytesPerPacket, device->bytesPerAddressEEPROM,
+                                 device->bytesPerWordEEPROM, device->family, end, data);
+        case CONFIG_MEMORY:
+            return comm->Program(start, device->bytesPerPacket, device->bytesPerAddressConfig,
+                                 device->bytesPerWordConfig, device->family, end, data);
+        default:
+            return Comm::Fail;
+    }
+}
+
+//Programs the extents of a range that was erased beforehand, each widened to whole packets so the
+//packets sent are the same ones Comm::Program() would send for them as part of the whole range.
+Comm::ErrorCode Programmer::ProgramExtents(const DeviceData::MemoryRange& hexRange)
+{
+    Comm::ErrorCode result = Comm::Success;
+    unsigned int bytesPerAddress = device->GetBytesPerAddress(hexRange.type);
+
+    foreach(DeviceData::Extent extent, DeviceData::AlignedExtents(hexRange, device->bytesPerPacket / bytesPerAddress))
+    {
+        result = ProgramRange(hexRange.type, extent.start, extent.end,
+                              hexRange.pDataBuffer + ((extent.start - hexRange.start) * bytesPerAddress));
+        if(result != Comm::Success)
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+//The full erase/program/verify sequence.
+Comm::ErrorCode Programmer::Write(DeviceData* hexData)
+{
+    Comm::ErrorCode result;
+
+    //A delta write leaves pages that already hold the new firmware alone.
+    if(deltaWrite)
+    {
+        result = WriteChangedPages(hexData);
+        if(result != Comm::IncorrectCommand)
+        {
+            if(result != Comm::Success)
+            {
+                return result;
+            }
+            return Verify(hexData);
+        }
+        qDebug("Bootloader can't erase single pages, erasing the whole device.");
+    }
+
+    //First erase the entire device.
+    result = Erase();
+    if(result != Comm::Success)
+    {
+        return result;
+    }
+
+    //Now being re-programming each section based on the info we obtained when
+    //we parsed the user's .hex file.
+    result = Program(hexData);
+    if(result != Comm::Success)
+    {
+        return result;
+    }
+
+    return Verify(hexData);
+}
+
+//Verifies the contents of the non-voltaile memory regions in the device, after an erase/programming cycle.
+//This function requests the memory contents of the device, then compares it against the parsed .hex file data to make sure
+//The locations that got programmed properly match.
+Comm::ErrorCode Programmer::Verify(DeviceData* hexData)
+{
+    Comm::ErrorCode result;
+    DeviceData::MemoryRange deviceRange, hexRange;
+    QTime elapsed;
+
+    unsigned int i;
+    bool failureDetected = false;
+    bool compared;
+    unsigned char flashData[MAX_ERASE_BLOCK_SIZE];
+    unsigned char hexEraseBlockData[MAX_ERASE_BLOCK_SIZE];
+    uint32_t startOfEraseBlock;
+    uint32_t errorAddress = 0;
+    uint16_t expectedResult = 0;
+    uint16_t actualResult = 0;
+
+    //Initialize an erase block sized buffer with 0xFF.
+    //Used later for post SIGN_FLASH verify operation.
+    memset(&hexEraseBlockData[0], 0xFF, MAX_ERASE_BLOCK_SIZE);
+
+    mismatchAddresses.clear();
+
+    emit IoWithDeviceStarted("Verifying Device...");
+    foreach(deviceRange, deviceData->ranges)
+    {
+        if(writeFlash && (deviceRange.type == PROGRAM_MEMORY))
+        {
+            elapsed.start();
+
+            //Where possible let the device checksum its flash, and only read back what differs.
+            result = Comm::IncorrectCommand;
+            if(crcVerify && !pageCrcUnsupported)
+            {
+                foreach(hexRange, hexData->ranges)
+                {
+                    if(deviceRange.start == hexRange.start)
+                    {
+                        result = ReadFlashByPageCrc(deviceRange, hexRange, hexData);
+                        break;
+                    }
+                }
+            }
+            if(result == Comm::IncorrectCommand)
+            {
+                result = ReadAndVerify(deviceRange, hexData, &compared);
+                if(compared)
+                {
+                    if(result != Comm::Success)
+                    {
+                        emit IoWithDeviceCompleted("Verify", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                        return Comm::Fail;
+                    }
+                    continue;
+                }
+            }
+
+            if(result != Comm::Success)
+            {
+                failureDetected = true;
+                qWarning("Error reading device.");
+            }
+
+            //Search through all of the programmable memory regions from the parsed .hex file data.
+            //For each of the programmable memory regions found, if the region also overlaps a region
+            //that was included in the device programmed area (which just got read back with GetData()),
+            //then verify both the parsed hex contents and read back data match.
+            foreach(hexRange, hexData->ranges)
+            {
+                if(deviceRange.start == hexRange.start)
+                {
+                    //Check the entire programmable memory address range against the hex file, apart from
+                    //the bytes this family doesn't implement.
+                    if(CompareRange(deviceRange, hexRange.pDataBuffer, "verify") != 0)
+                    {
+                        emit IoWithDeviceCompleted("Verify", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                        return Comm::Fail;
+                    }
+                }
+            }//foreach(hexRange, hexData->ranges)
+        }//if(writeFlash && (deviceRange.type == PROGRAM_MEMORY))
+        else if(writeEeprom && (deviceRange.type == EEPROM_MEMORY))
+        {
+            elapsed.start();
+
+            result = ReadAndVerify(deviceRange, hexData, &compared);
+            if(compared)
+            {
+                if(result != Comm::Success)
+                {
+                    emit IoWithDeviceCompleted("Verify EEPROM Memory", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                    return Comm::Fail;
+                }
+                continue;
+            }
+
+            if(result != Comm::Success)
+            {
+                failureDetected = true;
+                qWarning("Error reading device.");
+            }
+
+            //Search through all of the programmable memory regions from the parsed .hex file data.
+            //For each of the programmable memory regions found, if the region also overlaps a region
+            //that was included in the device programmed area (which just got read back with GetData()),
+            //then verify both the parsed hex contents and read back data match.
+            foreach(hexRange, hexData->ranges)
+            {
+                if(deviceRange.start == hexRange.start)
+                {
+                    //Check the entire programmable memory address range against the hex file, apart from
+                    //the bytes this family doesn't implement.
+                    if(CompareRange(deviceRange, hexRange.pDataBuffer, "verify") != 0)
+                    {
+                        emit IoWithDeviceCompleted("Verify EEPROM Memory", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                        return Comm::Fail;
+                    }
+                }
+            }//foreach(hexRange, hexData->ranges)
+        }//else if(writeEeprom && (deviceRange.type == EEPROM_MEMORY))
+        else if(writeConfig && (deviceRange.type == CONFIG_MEMORY))
+        {
+            elapsed.start();
+
+            result = ReadAndVerify(deviceRange, hexData, &compared);
+            if(compared)
+            {
+                if(result != Comm::Success)
+                {
+                    emit IoWithDeviceCompleted("Verify Config Bit Memory", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                    return Comm::Fail;
+                }
+                continue;
+            }
+
+            if(result != Comm::Success)
+            {
+                failureDetected = true;
+                qWarning("Error reading device.");
+            }
+
+            //Search through all of the programmable memory regions from the parsed .hex file data.
+            //For each of the programmable memory regions found, if the region also overlaps a region
+            //that was included in the device programmed area (which just got read back with GetData()),
+            //then verify both the parsed hex contents and read back data match.
+            foreach(hexRange, hexData->ranges)
+            {
+                if(deviceRange.start == hexRange.start)
+                {
+                    //Check the entire programmable memory address range against the hex file, apart from
+                    //the bytes this family doesn't implement.
+                    if(CompareRange(deviceRange, hexRange.pDataBuffer, "verify") != 0)
+                    {
+                        emit IoWithDeviceCompleted("Verify Config Bit Memory", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                        return Comm::Fail;
+                    }
+                }
+            }//foreach(hexRange, hexData->ranges)
+        }//else if(writeConfig && (deviceRange.type == CONFIG_MEMORY))
+        else
+        {
+            continue;
+        }
+    }//foreach(deviceRange, deviceData->ranges)
+
+    if(failureDetected == false)
+    {
+        //Successfully verified all regions without error.
+        //If this is a v1.01 or later device, we now need to issue the SIGN_FLASH
+        //command, and then re-verify the first erase page worth of flash memory
+        //(but with the exclusion of the signature WORD address from the verify,
+        //since the bootloader firmware will have changed it to the new/magic
+        //value (probably 0x600D, or "good" in leet speak).
+        if(deviceFirmwareIsAtLeast101 == true)
+        {
+            comm->SignFlash();
+
+            qDebug("Expected Signature Address: 0x%x", extendedBootInfo.PIC18.signatureAddress);
+            qDebug("Expected Signature Value: 0x%x", extendedBootInfo.PIC18.signatureValue);
+
+
+            //Now re-verify the first erase page of flash memory.
+            if(device->family == Device::PIC18)
+            {
+                startOfEraseBlock = extendedBootInfo.PIC18.signatureAddress - (extendedBootInfo.PIC18.signatureAddress % extendedBootInfo.PIC18.erasePageSize);
+                result = comm->GetData(startOfEraseBlock,
+                                       device->bytesPerPacket,
+                                       device->bytesPerAddressFLASH,
+                                       device->bytesPerWordFLASH,
+                                       (startOfEraseBlock + extendedBootInfo.PIC18.erasePageSize),
+                                       &flashData[0]);
+                if(result != Comm::Success)
+                {
+                    failureDetected = true;
+                    qWarning("Error reading, post signing, flash data block.");
+                }
+
+                //Search through all of the programmable memory regions from the parsed .hex file data.
+                //For each of the programmable memory regions found, if the region also overlaps a region
+                //that is part of the erase block, copy out bytes into the hexEraseBlockData[] buffer,
+                //for re-verification.
+                foreach(hexRange, hexData->ranges)
+                {
+                    //Check if any portion of the range is within the erase block of interest in the device.
+                    if((hexRange.start <= startOfEraseBlock) && (hexRange.end > startOfEraseBlock))
+                    {
+                        unsigned int rangeSize = hexRange.end - hexRange.start;
+                        unsigned int address = hexRange.start;
+                        unsigned int k = 0;
+
+                        //Check every byte in the hex file range, to see if it is inside the erase block of interest
+                        for(i = 0; i < rangeSize; i++)
+                        {
+                            //Check if the current byte we are looking at is inside the erase block of interst
+                            if(((address+i) >= startOfEraseBlock) && ((address+i) < (startOfEraseBlock + extendedBootInfo.PIC18.erasePageSize)))
+                            {
+                                //The byte is in the erase block of interst.  Copy it out into a new buffer.
+                                hexEraseBlockData[k] = *(hexRange.pDataBuffer + i);
+                                //Check if this is a signature byte.  If so, replace the value in the buffer
+                                //with the post-signing expected signature value, since this is now the expected
+                                //value from the device, rather than the value from the hex file...
+                                if((address+i) == extendedBootInfo.PIC18.signatureAddress)
+                                {
+                                    hexEraseBlockData[k] = (unsigned char)extendedBootInfo.PIC18.signatureValue;    //Write LSB of signature into buffer
+                                }
+                                if((address+i) == (extendedBootInfo.PIC18.signatureAddress + 1))
+                                {
+                                    hexEraseBlockData[k] = (unsigned char)(extendedBootInfo.PIC18.signatureValue >> 8); //Write MSB into buffer
+                                }
+                                k++;
+                            }
+                            if((k >= extendedBootInfo.PIC18.erasePageSize) || (k >= sizeof(hexEraseBlockData)))
+                                break;
+                        }//for(i = 0; i < rangeSize; i++)
+                    }
+                }//foreach(hexRange, hexData->ranges)
+
+                //We now have both the hex data and the post signing flash erase block data
+                //in two RAM buffers.  Compare them to each other to perform post-signing
+                //verify.
+                for(i = 0; i < extendedBootInfo.PIC18.erasePageSize; i++)
+                {
+                    if(flashData[i] != hexEraseBlockData[i])
+                    {
+                        failureDetected = true;
+                        qWarning("Post signing verify failure.");
+                        Erase();    //Send an erase command, to forcibly
+                        //remove the signature (which might be valid), since
+                        //there was a verify error and we can't trust the application
+                        //firmware image integrity.  This ensures the device jumps
+                        //back into bootloader mode always.
+
+                        errorAddress = startOfEraseBlock + i;
+                        expectedResult = hexEraseBlockData[i] + ((uint32_t)hexEraseBlockData[i+1] << 8);
+                        actualResult = flashData[i] + ((uint32_t)flashData[i+1] << 8);
+
+                        break;
+                    }
+                }//for(i = 0; i < extendedBootInfo.PIC18.erasePageSize; i++)
+            }//if(device->family == Device::PIC18)
+
+        }//if(deviceFirmwareIsAtLeast101 == true)
+
+    }//if(failureDetected == false)
+
+    if(failureDetected == true)
+    {
+        qDebug("Verify failed at address: 0x%x", errorAddress);
+        qDebug("Expected result: 0x%x", expectedResult);
+        qDebug("Actual result: 0x%x", actualResult);
+        emit AppendString("Operation aborted due to error encountered during verify operation.");
+        emit AppendString("Please try the erase/program/verify sequence again.");
+        emit AppendString("If repeated failures are encountered, this may indicate the flash");
+        emit AppendString("memory has worn out, that the device has been damaged, or that");
+        emit AppendString("there is some other unidentified problem.");
+
+        emit IoWithDeviceCompleted("Verify", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+        return Comm::Fail;
+    }
+
+    emit IoWithDeviceCompleted("Verify", Comm::Success, ((double)elapsed.elapsed()) / 1000);
+    emit AppendString("Erase/Program/Verify sequence completed successfully.");
+    emit AppendString("You may now unplug or reset the device.");
+    return Comm::Success;
+}
+
+//Delta programming: brings program memory up to date by erasing and programming only the erase
+//pages whose CRC on the device differs from hexData, then programs EEPROM and config bits as
+//Program() does.  Write() verifies and signs afterwards.
+//The page holding the signature is erased first whenever anything changes, so an update that is
+//interrupted half way leaves the device in the bootloader instead of running a mixed image.
+//Returns Comm::IncorrectCommand, before touching the device, if the bootloader can't do this.
+Comm::ErrorCode Programmer::WriteChangedPages(DeviceData* hexData)
+{
+    Comm::ErrorCode result = Comm::Success;
+    DeviceData::MemoryRange hexRange;
+    QVector<uint16_t> crcs;
+    QVector<FlashPage> changed;
+    QTime elapsed;
+    unsigned char signedPage[MAX_ERASE_BLOCK_SIZE];
+    uint32_t pageSize = extendedBootInfo.PIC18.erasePageSize;
+    uint32_t signatureAddress = extendedBootInfo.PIC18.signatureAddress;
+    uint32_t signaturePage;
+    uint32_t pageCount;
+    uint32_t address;
+    uint32_t i;
+    int signatureIndex = -1;
+    bool signatureChanged = false;
+    uint16_t blankCrc;
+    int first;
+    int last;
+
+    if(!deviceFirmwareIsAtLeast101 || pageCrcUnsupported || (device->family != Device::PIC18) ||
+       (device->bytesPerAddressFLASH != 1) || (pageSize == 0) || (pageSize > MAX_ERASE_BLOCK_SIZE))
+    {
+        return Comm::IncorrectCommand;
+    }
+    signaturePage = signatureAddress - (signatureAddress % pageSize);
+    blankCrc = BlankPageCrc(pageSize);
+
+    //Only whole pages can be erased, so every flash range has to be page aligned.
+    foreach(hexRange, hexData->ranges)
+    {
+        if(writeFlash && (hexRange.type == PROGRAM_MEMORY) &&
+           (((hexRange.start % pageSize) != 0) || ((hexRange.end % pageSize) != 0)))
+        {
+            return Comm::IncorrectCommand;
+        }
+    }
+
+    emit IoWithDeviceStarted("Writing Changed Pages...");
+    elapsed.start();
+
+    //Find the pages that differ.
+    foreach(hexRange, hexData->ranges)
+    {
+        if(!writeFlash || (hexRange.type != PROGRAM_MEMORY) || (hexRange.end <= hexRange.start))
+        {
+            continue;
+        }
+
+        pageCount = (hexRange.end - hexRange.start) / pageSize;
+        crcs.resize(pageCount);
+        result = comm->GetPageCrcs(hexRange.start, pageSize, pageCount, crcs.data());
+        if(result == Comm::IncorrectCommand)
+        {
+            //Nothing has been changed yet, Write() falls back to a full erase.
+            pageCrcUnsupported = true;
+            return result;
+        }
+        if(result != Comm::Success)
+        {
+            emit IoWithDeviceCompleted("Write", result, ((double)elapsed.elapsed()) / 1000);
+            return result;
+        }
+
+        for(i = 0; i < pageCount; i++)
+        {
+            FlashPage page;
+            page.address = hexRange.start + (i * pageSize);
+            page.data = &hexRange.pDataBuffer[i * pageSize];
+
+            if(page.address == signaturePage)
+            {
+                //A signed device holds the signature value instead of the hex data there.  The page
+                //is listed either way, in case other pages change.
+                SignedPage(page.data, page.address, pageSize, signedPage);
+                signatureChanged = (HexPageCrc(hexData, page.data, page.address, pageSize) != crcs[i]) &&
+                                   (FirmwareBundle::Crc16(signedPage, pageSize) != crcs[i]);
+                signatureIndex = changed.count();
+                changed.append(page);
+            }
+            else if(!DeviceData::HasData(hexRange, page.address, page.address + pageSize))
+            {
+                //Nothing to program in a page the hex file leaves blank, it only has to be erased.
+                if(crcs[i] != blankCrc)
+                {
+                    page.data = 0;
+                    changed.append(page);
+                }
+            }
+            else if(HexPageCrc(hexData, page.data, page.address, pageSize) != crcs[i])
+            {
+                changed.append(page);
+            }
+        }
+    }
+
+    //An unchanged signature page stays in the list only if something else has to be rewritten.
+    if((signatureIndex >= 0) && !signatureChanged && (changed.count() == 1))
+    {
+        changed.clear();
+        signatureIndex = -1;
+    }
+    qDebug("%d flash pages to rewrite.", changed.count());
+
+    //Erase the signature page first, then the rest.
+    if(signatureIndex >= 0)
+    {
+        result = comm->ErasePage(changed[signatureIndex].address);
+    }
+    for(i = 0; (result == Comm::Success) && (i < (uint32_t)changed.count()); i++)
+    {
+        if((int)i != signatureIndex)
+        {
+            result = comm->ErasePage(changed[i].address);
+        }
+    }
+
+    //Program runs of consecutive pages with one Program() call each.
+    for(first = 0; (result == Comm::Success) && (first < changed.count()); first = last + 1)
+    {
+        last = first;
+        if(changed[first].data == 0)
+        {
+            continue;
+        }
+        while(((last + 1) < changed.count()) &&
+              (changed[last + 1].address == (changed[last].address + pageSize)) &&
+              (changed[last + 1].data == (changed[last].data + pageSize)))
+        {
+            last++;
+        }
+        address = changed[last].address + pageSize;
+        result = ProgramRange(PROGRAM_MEMORY, changed[first].address, address, changed[first].data);
+    }
+
+    //EEPROM and config bits are rewritten in full, as by Program().
+    foreach(hexRange, hexData->ranges)
+    {
+        if(result != Comm::Success)
+        {
+            break;
+        }
+        if((writeEeprom && (hexRange.type == EEPROM_MEMORY)) ||
+           (writeConfig && (hexRange.type == CONFIG_MEMORY)))
+        {
+            result = ProgramRange(hexRange.type, hexRange.start, hexRange.end, hexRange.pDataBuffer);
+        }
+    }
+
+    if(result != Comm::Success)
+    {
+        qWarning("Programming failed");
+    }
+    emit IoWithDeviceCompleted("Write", result, ((double)elapsed.elapsed()) / 1000);
+    return result;
+}
+
+//Copies the pageSize bytes of data (or blank flash if data is 0) for the erase page at address into
+//page, with the signature word replaced by the value SIGN_FLASH leaves there, if it is in the page.
+void Programmer::SignedPage(const unsigned char* data, uint32_t address, uint32_t pageSize, unsigned char* page)
+{
+    uint32_t signatureAddress = extendedBootInfo.PIC18.signatureAddress;
+
+    if(data != 0)
+    {
+        memcpy(page, data, pageSize);
+    }
+    else
+    {
+        memset(page, 0xFF, pageSize);
+    }
+    if((signatureAddress >= address) && (signatureAddress < (address + pageSize)))
+    {
+        page[signatureAddress - address] = (unsigned char)extendedBootInfo.PIC18.signatureValue;
+    }
+    if(((signatureAddress + 1) >= address) && ((signatureAddress + 1) < (address + pageSize)))
+    {
+        page[signatureAddress + 1 - address] = (unsigned char)(extendedBootInfo.PIC18.signatureValue >> 8);
+    }
+}
+
+//Returns the mask Verify() compares a region against the hex data with: the device's CareMask(),
+//and on bootloaders that sign the flash, without the signature word.  A device that has been
+//signed before holds the signature value there, and Verify() checks that word after signing.
+QByteArray Programmer::VerifyMask(const DeviceData::MemoryRange& deviceRange)
+{
+    QByteArray mask = device->CareMask(deviceRange.type, deviceRange.start, deviceRange.end);
+    uint32_t signatureAddress = extendedBootInfo.PIC18.signatureAddress;
+    uint32_t address;
+
+    if(!deviceFirmwareIsAtLeast101 || (device->family != Device::PIC18) || (deviceRange.type != PROGRAM_MEMORY) ||
+       (device->bytesPerAddressFLASH != 1))
+    {
+        return mask;
+    }
+    for(address = signatureAddress; address < (signatureAddress + 2); address++)
+    {
+        if((address >= deviceRange.start) && (address < deviceRange.end))
+        {
+            if(mask.isEmpty())
+            {
+                mask.fill((char)0xFF, deviceRange.end - deviceRange.start);
+            }
+            mask[address - deviceRange.start] = 0x00;
+        }
+    }
+
+    return mask;
+}
+
+//Fills deviceRange.pDataBuffer with the device's program memory contents for Verify(), with as
+//little USB traffic as possible.  The bootloader reports a CRC for every erase page inside the
+//range.  Pages whose CRC matches the hex data are known to hold the hex data and are copied from
+//hexRange; the other pages, and any partial pages at the ends of the range, are read back with
+//GET_DATA.  Pages outside the extents of hexRange are expected to be blank and are never looked
+//at in its buffer, so BlankCheck() passes a range with no extents and no buffer.
+//When verifying, the page holding the signature also matches with the signature value in it, as
+//left by an earlier SIGN_FLASH.  Pages with don't-care bytes are always read back, since the CRC
+//covers whatever the device returns for those.  The CRCs of the hex data come from hexData, where
+//a firmware bundle precomputed them, and may be 0.
+//Returns Comm::IncorrectCommand if page CRCs can't be used, in which case the caller should read
+//the whole range back.
+Comm::ErrorCode Programmer::ReadFlashByPageCrc(DeviceData::MemoryRange& deviceRange, DeviceData::MemoryRange& hexRange, const DeviceData* hexData)
+{
+    Comm::ErrorCode result;
+    QVector<uint16_t> crcs;
+    QByteArray careMask;
+    unsigned char signedPage[MAX_ERASE_BLOCK_SIZE];
+    const unsigned char* expected = 0;
+    uint32_t pageSize = extendedBootInfo.PIC18.erasePageSize;
+    uint32_t signaturePage;
+    uint32_t firstPage;
+    uint32_t endOfPages;
+    uint32_t pageCount;
+    uint32_t page;
+    uint32_t address;
+    uint32_t readFrom;
+    uint32_t readTo;
+    uint32_t pagesReadBack = 0;
+    uint16_t blankCrc;
+    bool verifying = (hexRange.pDataBuffer != 0);
+
+    //Only PIC18 bootloaders report their erase page size, and there flash is byte addressed.
+    if(!deviceFirmwareIsAtLeast101 || (device->family != Device::PIC18) || (device->bytesPerAddressFLASH != 1) ||
+       (pageSize == 0) || (pageSize > MAX_ERASE_BLOCK_SIZE))
+    {
+        return Comm::IncorrectCommand;
+    }
+
+    firstPage = ((deviceRange.start + pageSize - 1) / pageSize) * pageSize;
+    endOfPages = (deviceRange.end / pageSize) * pageSize;
+    if(endOfPages <= firstPage)
+    {
+        return Comm::IncorrectCommand;
+    }
+    pageCount = (endOfPages - firstPage) / pageSize;
+    blankCrc = BlankPageCrc(pageSize);
+    careMask = device->CareMask(deviceRange.type, firstPage, endOfPages);
+    signaturePage = extendedBootInfo.PIC18.signatureAddress - (extendedBootInfo.PIC18.signatureAddress % pageSize);
+
+    crcs.resize(pageCount);
+    result = comm->GetPageCrcs(firstPage, pageSize, pageCount, crcs.data());
+    if(result == Comm::IncorrectCommand)
+    {
+        pageCrcUnsupported = true;
+    }
+    if(result != Comm::Success)
+    {
+        return result;
+    }
+
+    //Walk the range a page at a time, collecting runs of pages that have to be read back so each
+    //run costs a single GetData() call.  A partial page at the start of the range opens the first
+    //run, one at the end closes the last.
+    readFrom = deviceRange.start;
+    for(page = 0; page <= pageCount; page++)
+    {
+        address = firstPage + (page * pageSize);
+        if(page < pageCount)
+        {
+            if(!careMask.isEmpty() && (memchr(careMask.constData() + (address - firstPage), 0x00, pageSize) != 0))
+            {
+                pagesReadBack++;
+                continue;
+            }
+            expected = DeviceData::HasData(hexRange, address, address + pageSize) ? &hexRange.pDataBuffer[address - hexRange.start] : 0;
+            if((expected ? HexPageCrc(hexData, expected, address, pageSize) : blankCrc) != crcs[page])
+            {
+                if(!verifying || !deviceFirmwareIsAtLeast101 || (address != signaturePage))
+                {
+                    pagesReadBack++;
+                    continue;
+                }
+                SignedPage(expected, address, pageSize, signedPage);
+                if(FirmwareBundle::Crc16(signedPage, pageSize) != crcs[page])
+                {
+                    pagesReadBack++;
+                    continue;
+                }
+                expected = signedPage;
+            }
+            readTo = address;
+        }
+        else
+        {
+            readTo = deviceRange.end;
+        }
+
+        if(readFrom < readTo)
+        {
+            result = comm->GetData(readFrom,
+                                   device->bytesPerPacket,
+                                   device->bytesPerAddressFLASH,
+                                   device->bytesPerWordFLASH,
+                                   readTo,
+                                   &deviceRange.pDataBuffer[readFrom - deviceRange.start]);
+            if(result != Comm::Success)
+            {
+                return result;
+            }
+        }
+
+        //The device holds exactly the data for a page whose CRC matched.
+        if(page >= pageCount)
+        {
+            break;
+        }
+        if(expected != 0)
+        {
+            memcpy(&deviceRange.pDataBuffer[address - deviceRange.start], expected, pageSize);
+        }
+        else
+        {
+            memset(&deviceRange.pDataBuffer[address - deviceRange.start], 0xFF, pageSize);
+        }
+        readFrom = address + pageSize;
+    }
+
+    qDebug("Page CRCs checked, %u of %u flash pages read back.", pagesReadBack, pageCount);
+    return Comm::Success;
+}
+
+//Compares a region just read back from the device against expected, or against the blank value
+//0xFF if expected is 0, apart from the bytes this family doesn't implement (and, against expected,
+//the signature word, see VerifyMask()).  Every mismatching
+//device address is added to mismatchAddresses and the first few are logged.  Returns the number
+//of mismatching bytes.
+unsigned int Programmer::CompareRange(const DeviceData::MemoryRange& deviceRange, const unsigned char* expected, const char* operation)
+{
+    return CompareBytes(deviceRange, expected, 0,
+                        (deviceRange.end - deviceRange.start) * device->GetBytesPerAddress(deviceRange.type), operation);
+}
+
+//CompareRange() for only length bytes of the region, starting offset bytes into its buffer.
+unsigned int Programmer::CompareBytes(const DeviceData::MemoryRange& deviceRange, const unsigned char* expected,
+                                      unsigned int offset, unsigned int length, const char* operation)
+{
+    QByteArray careMask = expected ? VerifyMask(deviceRange) : device->CareMask(deviceRange.type, deviceRange.start, deviceRange.end);
+    unsigned int bytesPerAddress = device->GetBytesPerAddress(deviceRange.type);
+    QVector<unsigned int> offsets;
+    unsigned int found;
+    unsigned int position;
+    uint32_t address;
+    int i;
+
+    found = VerifyCompare(deviceRange.pDataBuffer + offset, expected ? (expected + offset) : 0,
+                          careMask.isEmpty() ? 0 : (const unsigned char*)careMask.constData() + offset,
+                          length, &offsets);
+
+    for(i = 0; i < offsets.count(); i++)
+    {
+        position = offset + offsets.at(i);
+        address = deviceRange.start + (position / bytesPerAddress);
+        if(mismatchAddresses.isEmpty() || (mismatchAddresses.last() != address))
+        {
+            mismatchAddresses.append(address);
+        }
+        if(i < MAX_LOGGED_MISMATCHES)
+        {
+            qWarning("Failed %s at address 0x%x: device 0x%x, expected 0x%x", operation, address,
+                     deviceRange.pDataBuffer[position], expected ? expected[position] : 0xFF);
+        }
+    }
+    if(found > MAX_LOGGED_MISMATCHES)
+    {
+        qWarning("%u mismatching bytes in the region at 0x%x.", found, deviceRange.start);
+    }
+
+    return found;
+}
+
+//Reads a region back into deviceRange.pDataBuffer for Verify().  If hexData has data for the
+//region, each GET_DATA reply is compared as soon as it arrives, and the read stops at the first
+//packet that really differs instead of fetching the rest of the region.  *compared tells whether
+//that happened: the result is then Success for a match, or Fail with the differences in the
+//offending packet logged.  Otherwise the caller still has to compare the data itself.
+Comm::ErrorCode Programmer::ReadAndVerify(DeviceData::MemoryRange& deviceRange, DeviceData* hexData, bool* compared)
+{
+    Comm::ErrorCode result;
+    DeviceData::MemoryRange hexRange;
+    QByteArray careMask;
+    QVector<DeviceData::Extent> extents;
+    unsigned int bytesPerAddress = device->GetBytesPerAddress(deviceRange.type);
+    unsigned int bytesPerWord;
+
+    *compared = false;
+
+    if(deviceRange.type == PROGRAM_MEMORY)
+    {
+        bytesPerWord = device->bytesPerWordFLASH;
+    }
+    else if(deviceRange.type == EEPROM_MEMORY)
+    {
+        bytesPerWord = device->bytesPerWordEEPROM;
+    }
+    else
+    {
+        bytesPerWord = device->bytesPerWordConfig;
+    }
+
+    foreach(hexRange, hexData->ranges)
+    {
+        if(deviceRange.start == hexRange.start)
+        {
+            careMask = VerifyMask(deviceRange);
+            StreamCompare sink(deviceRange.pDataBuffer, hexRange.pDataBuffer,
+                               careMask.isEmpty() ? 0 : (const unsigned char*)careMask.constData());
+
+            //Flash was erased before programming, so only the packets holding hex data are read
+            //back.  EEPROM and config bits are programmed and checked in full, and so is flash
+            //when a full verify was asked for.
+            if((deviceRange.type == PROGRAM_MEMORY) && crcVerify)
+            {
+                extents = DeviceData::AlignedExtents(hexRange, device->bytesPerPacket / bytesPerAddress);
+            }
+            else
+            {
+                DeviceData::Extent whole;
+                whole.start = deviceRange.start;
+                whole.end = deviceRange.end;
+                extents.append(whole);
+            }
+
+            result = Comm::Success;
+            foreach(DeviceData::Extent extent, extents)
+            {
+                sink.base = (extent.start - deviceRange.start) * bytesPerAddress;
+                result = comm->GetData(extent.start,
+                                       device->bytesPerPacket,
+                                       bytesPerAddress,
+                                       bytesPerWord,
+                                       extent.end,
+                                       deviceRange.pDataBuffer + sink.base,
+                                       &sink);
+                if(result != Comm::Success)
+                {
+                    break;
+                }
+            }
+            if(sink.failed)
+            {
+                CompareBytes(deviceRange, hexRange.pDataBuffer, sink.failedOffset, sink.failedLength, "verify");
+                *compared = true;
+                return Comm::Fail;
+            }
+            *compared = (result == Comm::Success);
+            return result;
+        }
+    }
+
+    return comm->GetData(deviceRange.start,
+                         device->bytesPerPacket,
+                         bytesPerAddress,
+                         bytesPerWord,
+                         deviceRange.end,
+                         deviceRange.pDataBuffer);
+}
+
+Comm::ErrorCode Programmer::BlankCheck(void)
+{
+    QTime elapsed;
+    Comm::ErrorCode result;
+    DeviceData::MemoryRange deviceRange;
+
+    elapsed.start();
+    mismatchAddresses.clear();
+
+    foreach(deviceRange, deviceData->ranges)
+    {
+        if(writeFlash && (deviceRange.type == PROGRAM_MEMORY))
+        {
+            emit IoWithDeviceStarted("Blank Checking Device's Program Memory...");
+
+            //Where possible only the pages whose CRC isn't that of a blank page are read back.
+            result = Comm::IncorrectCommand;
+            if(crcVerify && !pageCrcUnsupported)
+            {
+                DeviceData::MemoryRange blankRange = deviceRange;
+                blankRange.pDataBuffer = 0;
+                blankRange.extents.clear();
+                result = ReadFlashByPageCrc(deviceRange, blankRange, 0);
+            }
+            if(result == Comm::IncorrectCommand)
+            {
+                result = comm->GetData(deviceRange.start,
+                                       device->bytesPerPacket,
+                                       device->bytesPerAddressFLASH,
+                                       device->bytesPerWordFLASH,
+                                       deviceRange.end,
+                                       deviceRange.pDataBuffer);
+            }
+
+
+            if(result != Comm::Success)
+            {
+                qWarning("Blank Check failed");
+                emit IoWithDeviceCompleted("Blank Checking Program Memory", result, ((double)elapsed.elapsed()) / 1000);
+                return result;
+            }
+
+            //Everything should read back as 0xFF, apart from the PIC24 phantom bytes.
+            if(CompareRange(deviceRange, 0, "blank check") != 0)
+            {
+                emit IoWithDeviceCompleted("Blank Check", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                return Comm::Fail;
+            }
+            emit IoWithDeviceCompleted("Blank Checking Program Memory", Comm::Success, ((double)elapsed.elapsed()) / 1000);
+        }
+        else if(writeEeprom && deviceRange.type == EEPROM_MEMORY)
+        {
+            emit IoWithDeviceStarted("Blank Checking Device's EEPROM Memory...");
+
+            result = comm->GetData(deviceRange.start,
+                                   device->bytesPerPacket,
+                                   device->bytesPerAddressEEPROM,
+                                   device->bytesPerWordEEPROM,
+                                   deviceRange.end,
+                                   deviceRange.pDataBuffer);
+
+
+            if(result != Comm::Success)
+            {
+                qWarning("Blank Check failed");
+                emit IoWithDeviceCompleted("Blank Checking EEPROM Memory", result, ((double)elapsed.elapsed()) / 1000);
+                return result;
+            }
+
+            if(CompareRange(deviceRange, 0, "blank check") != 0)
+            {
+                emit IoWithDeviceCompleted("Blank Check", Comm::Fail, ((double)elapsed.elapsed()) / 1000);
+                return Comm::Fail;
+            }
+            emit IoWithDeviceCompleted("Blank Checking EEPROM Memory", Comm::Success, ((double)elapsed.elapsed()) / 1000);
+        }
+        else
+        {
+            continue;
+        }
+    }
+
+    return Comm::Success;
+}
@@ -0,0 +1,115 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef PROGRAMMER_H
+#define PROGRAMMER_H
+
+#include <QObject>
+#include <QString>
+
+#include "Comm.h"
+#include "DeviceData.h"
+#include "Device.h"
+#include "ImportExportHex.h"
+
+/*!
+ * Runs the query/erase/program/verify/blank check sequences against one
+ * bootloader.  Holds no GUI state, so it can be driven from MainWindow, a
+ * command line tool, or one worker thread per device.
+ */
+class Programmer : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void IoWithDeviceCompleted(QString msg, Comm::ErrorCode, double time);
+    void IoWithDeviceStarted(QString msg);
+    void AppendString(QString msg);
+
+public:
+    Programmer(Comm* comm, Device* device, DeviceData* deviceData, QObject *parent = 0);
+
+    Comm::ErrorCode Query(void);
+    HexImporter::ErrorCode ImportHexFile(QString fileName, DeviceData* hexData, HexImporter& import);
+
+    Comm::ErrorCode Erase(void);
+    Comm::ErrorCode Program(DeviceData* hexData);
+    Comm::ErrorCode Write(DeviceData* hexData);
+    Comm::ErrorCode Verify(DeviceData* hexData);
+    Comm::ErrorCode BlankCheck(void);
+
+    static void FreeRanges(DeviceData* data);
+    unsigned int ErasePageSize(void);
+
+    //Which regions Program(), Verify() and BlankCheck() operate on.
+    bool writeFlash;
+    bool writeEeprom;
+    bool writeConfig;
+
+    //Verify() compares erase page CRCs and only reads back the flash pages that differ, when the
+    //bootloader supports GET_PAGE_CRC.  Otherwise all of program memory is read back.
+    bool crcVerify;
+
+    //Write() only erases and programs the flash pages whose CRC differs from the hex data, when
+    //the bootloader supports GET_PAGE_CRC and ERASE_PAGE.  Otherwise the whole device is erased.
+    bool deltaWrite;
+
+    //Device addresses that failed the last Verify() or BlankCheck(), in address order per region.
+    QVector<uint32_t> mismatchAddresses;
+
+    //Filled in by Query().
+    bool deviceFirmwareIsAtLeast101;
+    Comm::ExtendedQueryInfo extendedBootInfo;
+
+protected:
+    //A flash erase page and the hex data that belongs in it, or 0 if it is to be left blank.
+    struct FlashPage
+    {
+        uint32_t address;
+        unsigned char* data;
+    };
+
+    Comm::ErrorCode ProgramRange(unsigned char type, uint32_t start, uint32_t end, unsigned char* data);
+    Comm::ErrorCode ProgramExtents(const DeviceData::MemoryRange& hexRange);
+    Comm::ErrorCode WriteChangedPages(DeviceData* hexData);
+    void SignedPage(const unsigned char* data, uint32_t address, uint32_t pageSize, unsigned char* page);
+    QByteArray VerifyMask(const DeviceData::MemoryRange& deviceRange);
+    unsigned int CompareRange(const DeviceData::MemoryRange& deviceRange, const unsigned char* expected, const char* operation);
+    unsigned int CompareBytes(const DeviceData::MemoryRange& deviceRange, const unsigned char* expected,
+                              unsigned int offset, unsigned int length, const char* operation);
+    Comm::ErrorCode ReadAndVerify(DeviceData::MemoryRange& deviceRange, DeviceData* hexData, bool* compared);
+    Comm::ErrorCode ReadFlashByPageCrc(DeviceData::MemoryRange& deviceRange, DeviceData::MemoryRange& hexRange, const DeviceData* hexData);
+    static uint16_t HexPageCrc(const DeviceData* hexData, const unsigned char* data, uint32_t address, uint32_t pageSize);
+
+    bool pageCrcUnsupported;    //the bootloader ignored GET_PAGE_CRC, don't ask again until the next Query()
+
+    Comm* comm;
+    Device* device;
+    DeviceData* deviceData;
+};
+
+#endif // PROGRAMMER_H
@@ -72,6 +72,12 @@ void Settings::setWriteConfig(bool value)
     alreadyWarnedConfigBitWrite = warnedFlag;
 }
 
+void Settings::setDeltaWrite(bool value)
+{
+    deltaWrite = value;
+    m_ui->DeltaWriteCheckBox->setChecked(value);
+}
+
 void Settings::changeEvent(QEvent *e)
 {
     switch (e->type())
@@ -89,6 +95,7 @@ void Settings::on_buttonBox_accepted()
     writeFlash = m_ui->FlashProgramMemorycheckBox->isChecked();
     writeConfig = m_ui->ConfigBitsCheckBox->isChecked();
     writeEeprom = m_ui->EepromCheckBox->isChecked();
+    deltaWrite = m_ui->DeltaWriteCheckBox->isChecked();
 }
 
 void Settings::on_ConfigBitsCheckBox_toggled(bool checked)
@@ -53,10 +53,12 @@ public:
     void setWriteFlash(bool value);
     void setWriteEeprom(bool value);
     void setWriteConfig(bool value);
+    void setDeltaWrite(bool value);
 
     bool writeFlash;
     bool writeEeprom;
     bool writeConfig;
+    bool deltaWrite;
 
     bool hasEeprom;
     bool hasConfig;
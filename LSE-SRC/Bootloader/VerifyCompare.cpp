@@ -0,0 +1,207 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include "VerifyCompare.h"
+#include "CpuFeatures.h"
+
+#ifdef CPU_FEATURES_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+typedef unsigned int (*VerifyCompareKernel)(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                                            unsigned int count, unsigned int offset, QVector<unsigned int>* mismatches);
+
+//The vector kernels work on blocks of this many bytes, one bit per byte in a 64-bit word.
+#define VERIFY_COMPARE_BLOCK 64
+
+//offset is added to every reported position, so the vector kernels can hand their tail over.
+static unsigned int CompareScalar(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                                  unsigned int count, unsigned int offset, QVector<unsigned int>* mismatches)
+{
+    unsigned int found = 0;
+
+    for(unsigned int i = 0; i < count; i++)
+    {
+        unsigned char difference = actual[i] ^ (expected ? expected[i] : 0xFF);
+        if(careMask)
+        {
+            difference &= careMask[i];
+        }
+        if(difference)
+        {
+            found++;
+            if(mismatches)
+            {
+                mismatches->append(offset + i);
+            }
+        }
+    }
+
+    return found;
+}
+
+#ifdef CPU_FEATURES_X86
+//Index of the lowest set bit of a non-zero word.
+static inline unsigned int LowestSetBit(quint64 bits)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return index;
+#else
+    unsigned long index;
+    if((unsigned long)bits)
+    {
+        _BitScanForward(&index, (unsigned long)bits);
+        return index;
+    }
+    _BitScanForward(&index, (unsigned long)(bits >> 32));
+    return index + 32;
+#endif
+}
+
+//Counts the set bits of a block's mismatch word and records their positions.
+static inline unsigned int ReportBlock(quint64 bits, unsigned int position, QVector<unsigned int>* mismatches)
+{
+    unsigned int found = 0;
+
+    while(bits)
+    {
+        found++;
+        if(mismatches)
+        {
+            mismatches->append(position + LowestSetBit(bits));
+        }
+        bits &= bits - 1;
+    }
+
+    return found;
+}
+
+CPU_TARGET("sse2")
+static unsigned int CompareSSE2(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                                unsigned int count, unsigned int offset, QVector<unsigned int>* mismatches)
+{
+    const __m128i blank = _mm_set1_epi8((char)0xFF);
+    unsigned int found = 0;
+    unsigned int i = 0;
+
+    for(; (i + VERIFY_COMPARE_BLOCK) <= count; i += VERIFY_COMPARE_BLOCK)
+    {
+        quint64 bits = 0;
+
+        for(int lane = 0; lane < 4; lane++)
+        {
+            __m128i device = _mm_loadu_si128((const __m128i*)&actual[i + (16 * lane)]);
+            __m128i wanted = expected ? _mm_loadu_si128((const __m128i*)&expected[i + (16 * lane)]) : blank;
+            unsigned int differ = ~_mm_movemask_epi8(_mm_cmpeq_epi8(device, wanted)) & 0xFFFF;
+            if(careMask)
+            {
+                differ &= _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)&careMask[i + (16 * lane)]));
+            }
+            bits |= (quint64)differ << (16 * lane);
+        }
+
+        if(bits)
+        {
+            found += ReportBlock(bits, offset + i, mismatches);
+        }
+    }
+
+    return found + CompareScalar(&actual[i], expected ? &expected[i] : 0, careMask ? &careMask[i] : 0,
+                                 count - i, offset + i, mismatches);
+}
+
+CPU_TARGET("avx2")
+static unsigned int CompareAVX2(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                                unsigned int count, unsigned int offset, QVector<unsigned int>* mismatches)
+{
+    const __m256i blank = _mm256_set1_epi8((char)0xFF);
+    unsigned int found = 0;
+    unsigned int i = 0;
+
+    for(; (i + VERIFY_COMPARE_BLOCK) <= count; i += VERIFY_COMPARE_BLOCK)
+    {
+        __m256i deviceLow = _mm256_loadu_si256((const __m256i*)&actual[i]);
+        __m256i deviceHigh = _mm256_loadu_si256((const __m256i*)&actual[i + 32]);
+        __m256i wantedLow = expected ? _mm256_loadu_si256((const __m256i*)&expected[i]) : blank;
+        __m256i wantedHigh = expected ? _mm256_loadu_si256((const __m256i*)&expected[i + 32]) : blank;
+        quint64 bits = ~(((quint64)(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(deviceHigh, wantedHigh)) << 32) |
+                         (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(deviceLow, wantedLow)));
+        if(careMask && bits)
+        {
+            bits &= ((quint64)(unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)&careMask[i + 32])) << 32) |
+                    (unsigned int)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)&careMask[i]));
+        }
+
+        if(bits)
+        {
+            found += ReportBlock(bits, offset + i, mismatches);
+        }
+    }
+
+    return found + CompareSSE2(&actual[i], expected ? &expected[i] : 0, careMask ? &careMask[i] : 0,
+                               count - i, offset + i, mismatches);
+}
+
+#endif // CPU_FEATURES_X86
+
+//Runs during static initialisation.
+static VerifyCompareKernel SelectKernel(const char** name)
+{
+#ifdef CPU_FEATURES_X86
+    if(CpuHasAVX2())
+    {
+        *name = "avx2";
+        return CompareAVX2;
+    }
+    if(CpuHasSSE2())
+    {
+        *name = "sse2";
+        return CompareSSE2;
+    }
+#endif
+    *name = "scalar";
+    return CompareScalar;
+}
+
+static const char* kernelName;
+static const VerifyCompareKernel kernel = SelectKernel(&kernelName);
+
+unsigned int VerifyCompare(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                           unsigned int count, QVector<unsigned int>* mismatches)
+{
+    return kernel(actual, expected, careMask, count, 0, mismatches);
+}
+
+const char* VerifyCompareKernelName(void)
+{
+    return kernelName;
+}
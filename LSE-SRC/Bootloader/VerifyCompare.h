@@ -0,0 +1,51 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#ifndef VERIFYCOMPARE_H
+#define VERIFYCOMPARE_H
+
+#include <QVector>
+
+/*!
+ * Compares count bytes read back from a device against the expected bytes,
+ * or against the erased value 0xFF when expected is 0 (blank check).  Bytes
+ * whose careMask byte is 0x00 are don't-cares, bytes whose careMask byte is
+ * 0xFF have to match; careMask may be 0 when every byte matters.
+ *
+ * The buffer offset of every mismatching byte is appended to mismatches (if
+ * not 0), in order, and the number of mismatching bytes is returned.
+ *
+ * Uses an AVX2 or SSE2 kernel comparing 64 bytes at a time when the CPU
+ * supports it, chosen once at run time, and a plain loop otherwise.
+ */
+unsigned int VerifyCompare(const unsigned char* actual, const unsigned char* expected, const unsigned char* careMask,
+                           unsigned int count, QVector<unsigned int>* mismatches);
+
+//Name of the kernel VerifyCompare() selected on this CPU ("avx2", "sse2" or "scalar").
+const char* VerifyCompareKernelName(void);
+
+#endif // VERIFYCOMPARE_H
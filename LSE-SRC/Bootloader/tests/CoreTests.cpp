@@ -0,0 +1,769 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <string.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+
+#include "../DeviceData.h"
+#include "../Device.h"
+#include "../FirmwareBundle.h"
+#include "../HexCache.h"
+#include "../HexDecode.h"
+#include "../ImportExportHex.h"
+#include "../VerifyCompare.h"
+
+//Layout the importer tests lay their files out for, the same as the simulated PIC18.
+#define TEST_FLASH_START    0x1000
+#define TEST_FLASH_END      0x4000
+#define TEST_EEPROM_START   0xF00000
+#define TEST_EEPROM_END     0xF00100
+#define TEST_CONFIG_START   0x300000
+#define TEST_CONFIG_END     0x30000E
+
+/*!
+ * Unit tests for the parts of the core that don't need a device.
+ */
+class CoreTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void addExtentMerges();
+    void alignedExtents();
+    void hasData();
+    void hexAddressIndex();
+    void hexDecodePairs();
+    void verifyCompare();
+    void crc16();
+    void firmwareBundle();
+    void importIntelHex();
+    void importIntelHexParallel();
+    void importSRecord();
+    void importElf();
+    void importBinary();
+
+private:
+    static DeviceData::MemoryRange Range(unsigned char type, unsigned int start, unsigned int end, unsigned int bytesPerAddress);
+    static void AddTestLayout(DeviceData* data);
+    static void FreeRanges(DeviceData* data);
+    static QByteArray HexRecord(unsigned char type, unsigned int address, const QByteArray& data);
+    static QByteArray SRecord(char type, unsigned int address, const QByteArray& data);
+    static QByteArray TestBytes(int length, unsigned int seed);
+    bool WriteFile(QString fileName, const QByteArray& contents);
+    HexImporter::ErrorCode Import(QString fileName, const QByteArray& contents, DeviceData* data, Device* device, HexImporter& import);
+
+    QTemporaryDir dir;
+};
+
+//Small linear congruential generator, so every run sees the same data.
+static unsigned int NextRandom(unsigned int* seed)
+{
+    *seed = (*seed * 1103515245) + 12345;
+    return (*seed >> 16) & 0x7FFF;
+}
+
+DeviceData::MemoryRange CoreTests::Range(unsigned char type, unsigned int start, unsigned int end, unsigned int bytesPerAddress)
+{
+    DeviceData::MemoryRange range;
+
+    range.type = type;
+    range.start = start;
+    range.end = end;
+    range.dataBufferLength = (end - start) * bytesPerAddress;
+    range.pDataBuffer = new unsigned char[range.dataBufferLength];
+    memset(range.pDataBuffer, 0xFF, range.dataBufferLength);
+    return range;
+}
+
+void CoreTests::AddTestLayout(DeviceData* data)
+{
+    data->ranges.append(Range(PROGRAM_MEMORY, TEST_FLASH_START, TEST_FLASH_END, 1));
+    data->ranges.append(Range(EEPROM_MEMORY, TEST_EEPROM_START, TEST_EEPROM_END, 1));
+    data->ranges.append(Range(CONFIG_MEMORY, TEST_CONFIG_START, TEST_CONFIG_END, 1));
+}
+
+void CoreTests::FreeRanges(DeviceData* data)
+{
+    foreach(DeviceData::MemoryRange range, data->ranges)
+    {
+        delete [] range.pDataBuffer;
+    }
+    data->ranges.clear();
+}
+
+//Formats one Intel hex record.
+QByteArray CoreTests::HexRecord(unsigned char type, unsigned int address, const QByteArray& data)
+{
+    QByteArray bytes;
+    unsigned char sum = 0;
+    int i;
+
+    bytes.append((char)data.size());
+    bytes.append((char)(address >> 8));
+    bytes.append((char)address);
+    bytes.append((char)type);
+    bytes.append(data);
+    for(i = 0; i < bytes.size(); i++)
+    {
+        sum += (unsigned char)bytes.at(i);
+    }
+    bytes.append((char)-sum);
+
+    return ":" + bytes.toHex().toUpper() + "\n";
+}
+
+//Formats one S1/S2/S3 (or S7/S8/S9) record for address and data.
+QByteArray CoreTests::SRecord(char type, unsigned int address, const QByteArray& data)
+{
+    int addressLength = ((type == '1') || (type == '9')) ? 2 : (((type == '2') || (type == '8')) ? 3 : 4);
+    QByteArray bytes;
+    unsigned char sum = 0;
+    int i;
+
+    bytes.append((char)(addressLength + data.size() + 1));
+    for(i = addressLength - 1; i >= 0; i--)
+    {
+        bytes.append((char)(address >> (8 * i)));
+    }
+    bytes.append(data);
+    for(i = 0; i < bytes.size(); i++)
+    {
+        sum += (unsigned char)bytes.at(i);
+    }
+    bytes.append((char)~sum);
+
+    return QByteArray("S") + type + bytes.toHex().toUpper() + "\n";
+}
+
+QByteArray CoreTests::TestBytes(int length, unsigned int seed)
+{
+    QByteArray bytes;
+
+    while(bytes.size() < length)
+    {
+        bytes.append((char)NextRandom(&seed));
+    }
+    return bytes;
+}
+
+bool CoreTests::WriteFile(QString fileName, const QByteArray& contents)
+{
+    QFile file(fileName);
+
+    return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+}
+
+//Writes contents to fileName and imports it into a fresh test layout.  The caller frees the ranges.
+HexImporter::ErrorCode CoreTests::Import(QString fileName, const QByteArray& contents, DeviceData* data, Device* device, HexImporter& import)
+{
+    AddTestLayout(data);
+    if(!WriteFile(fileName, contents))
+    {
+        return HexImporter::CouldNotOpenFile;
+    }
+    return import.ImportHexFile(fileName, data, device);
+}
+
+void CoreTests::initTestCase()
+{
+    //Every import has to go through the parser under test.
+    HexCache::setEnabled(false);
+    QVERIFY(dir.isValid());
+}
+
+void CoreTests::addExtentMerges()
+{
+    DeviceData::MemoryRange range = Range(PROGRAM_MEMORY, 0x1000, 0x2000, 1);
+
+    DeviceData::AddExtent(range, 0x1100, 0x1110);
+    DeviceData::AddExtent(range, 0x1200, 0x1210);
+    DeviceData::AddExtent(range, 0x1000, 0x1008);
+    DeviceData::AddExtent(range, 0x1300, 0x1300);
+    QCOMPARE(range.extents.count(), 3);
+    QCOMPARE(range.extents[0].start, 0x1000u);
+    QCOMPARE(range.extents[1].start, 0x1100u);
+
+    //Touching extents merge, and one that bridges several swallows them.
+    DeviceData::AddExtent(range, 0x1008, 0x1010);
+    QCOMPARE(range.extents.count(), 3);
+    QCOMPARE(range.extents[0].end, 0x1010u);
+    DeviceData::AddExtent(range, 0x1108, 0x1204);
+    QCOMPARE(range.extents.count(), 2);
+    QCOMPARE(range.extents[1].start, 0x1100u);
+    QCOMPARE(range.extents[1].end, 0x1210u);
+
+    delete [] range.pDataBuffer;
+}
+
+void CoreTests::alignedExtents()
+{
+    DeviceData::MemoryRange range = Range(PROGRAM_MEMORY, 0x1000, 0x2000, 1);
+    QVector<DeviceData::Extent> aligned;
+
+    DeviceData::AddExtent(range, 0x1005, 0x1009);
+    DeviceData::AddExtent(range, 0x1030, 0x1031);
+    DeviceData::AddExtent(range, 0x1FF0, 0x2000);
+
+    //56 address blocks counted from the range start; the first two extents share a block and the
+    //last block is clipped to the range.
+    aligned = DeviceData::AlignedExtents(range, 56);
+    QCOMPARE(aligned.count(), 2);
+    QCOMPARE(aligned[0].start, 0x1000u);
+    QCOMPARE(aligned[0].end, 0x1038u);
+    QCOMPARE(aligned[1].start, 0x1FC0u);
+    QCOMPARE(aligned[1].end, 0x2000u);
+
+    aligned = DeviceData::AlignedExtents(range, 0);
+    QCOMPARE(aligned.count(), 3);
+    QCOMPARE(aligned[1].start, 0x1030u);
+    QCOMPARE(aligned[1].end, 0x1031u);
+
+    delete [] range.pDataBuffer;
+}
+
+void CoreTests::hasData()
+{
+    DeviceData::MemoryRange range = Range(PROGRAM_MEMORY, 0x1000, 0x2000, 1);
+
+    QVERIFY(!DeviceData::HasData(range, 0x1000, 0x2000));
+    DeviceData::AddExtent(range, 0x1100, 0x1110);
+    DeviceData::AddExtent(range, 0x1200, 0x1210);
+    QVERIFY(DeviceData::HasData(range, 0x1000, 0x2000));
+    QVERIFY(DeviceData::HasData(range, 0x110F, 0x1110));
+    QVERIFY(DeviceData::HasData(range, 0x1150, 0x1201));
+    QVERIFY(!DeviceData::HasData(range, 0x1110, 0x1200));
+    QVERIFY(!DeviceData::HasData(range, 0x1000, 0x1100));
+    QVERIFY(!DeviceData::HasData(range, 0x1105, 0x1105));
+
+    delete [] range.pDataBuffer;
+}
+
+void CoreTests::hexAddressIndex()
+{
+    DeviceData data;
+    Device device(&data);
+    HexAddressIndex index;
+    const HexAddressIndex::Region* region;
+
+    //Word addressed: every device address holds two .hex file bytes.
+    device.family = Device::PIC24;
+    device.bytesPerAddressFLASH = 2;
+    device.bytesPerAddressEEPROM = 2;
+    device.bytesPerAddressConfig = 2;
+    data.ranges.append(Range(PROGRAM_MEMORY, 0x400, 0x800, 2));
+    data.ranges.append(Range(CONFIG_MEMORY, 0xF80000, 0xF80010, 2));
+    data.ranges.append(Range(PROGRAM_MEMORY, 0x700, 0x900, 2));
+    index.Build(&device, &data);
+
+    QCOMPARE(index.regions.count(), 3);
+    region = index.Find(0x800);
+    QVERIFY(region != 0);
+    QCOMPARE(region->hexStart, (quint64)0x800);
+    QCOMPARE(region->hexEnd, (quint64)0x1000);
+    QVERIFY(region->pDataBuffer == data.ranges[0].pDataBuffer);
+
+    //Below every region Find() returns the first one above.
+    QVERIFY(index.Find(0x7FF) == region);
+
+    //The overlapping range only keeps the part the first one doesn't cover.
+    region = index.Find(0x1000);
+    QVERIFY(region != 0);
+    QCOMPARE(region->hexStart, (quint64)0x1000);
+    QCOMPARE(region->hexEnd, (quint64)0x1200);
+    QCOMPARE(region->range, 2);
+    QVERIFY(region->pDataBuffer == data.ranges[2].pDataBuffer + 0x200);
+
+    region = index.Find(0x1200);
+    QVERIFY(region != 0);
+    QCOMPARE(region->type, (unsigned char)CONFIG_MEMORY);
+    QCOMPARE(region->hexStart, (quint64)0x1F00000);
+    QVERIFY(index.Find(0x1F00020) == 0);
+
+    FreeRanges(&data);
+}
+
+void CoreTests::hexDecodePairs()
+{
+    static const char digits[] = "0123456789abcdefABCDEF";
+    char ascii[600];
+    unsigned char binary[300];
+    unsigned char sum;
+    unsigned char expectedSum;
+    unsigned int seed = 1;
+    unsigned int count;
+    unsigned int i;
+    int run;
+
+    qDebug("HexDecodePairs() kernel: %s", HexDecodeKernelName());
+
+    for(run = 0; run < 2000; run++)
+    {
+        count = NextRandom(&seed) % 260;
+        for(i = 0; i < 2 * count; i++)
+        {
+            ascii[i] = digits[NextRandom(&seed) % 22];
+        }
+
+        sum = 7;
+        QVERIFY(HexDecodePairs(ascii, binary, count, &sum));
+        expectedSum = 7;
+        for(i = 0; i < count; i++)
+        {
+            char pair[3] = { ascii[2 * i], ascii[(2 * i) + 1], 0 };
+            QCOMPARE((unsigned int)binary[i], (unsigned int)strtoul(pair, NULL, 16));
+            expectedSum += binary[i];
+        }
+        QCOMPARE(sum, expectedSum);
+
+        //A single bad character anywhere fails the whole run.
+        if(count > 0)
+        {
+            ascii[NextRandom(&seed) % (2 * count)] = 'g';
+            QVERIFY(!HexDecodePairs(ascii, binary, count, &sum));
+        }
+    }
+}
+
+void CoreTests::verifyCompare()
+{
+    unsigned char actual[300];
+    unsigned char expected[300];
+    unsigned char careMask[300];
+    QVector<unsigned int> mismatches;
+    QVector<unsigned int> reference;
+    unsigned int seed = 2;
+    unsigned int count;
+    unsigned int i;
+    unsigned char difference;
+    bool blank;
+    bool masked;
+    int run;
+
+    qDebug("VerifyCompare() kernel: %s", VerifyCompareKernelName());
+
+    //The selected kernel against a plain byte by byte comparison.
+    for(run = 0; run < 3000; run++)
+    {
+        count = NextRandom(&seed) % 300;
+        blank = ((run % 3) == 0);
+        masked = ((run % 2) == 0);
+        for(i = 0; i < count; i++)
+        {
+            expected[i] = NextRandom(&seed);
+            actual[i] = ((NextRandom(&seed) % 8) == 0) ? NextRandom(&seed) : expected[i];
+            if(blank)
+            {
+                actual[i] = ((NextRandom(&seed) % 8) == 0) ? NextRandom(&seed) : 0xFF;
+            }
+            careMask[i] = ((NextRandom(&seed) % 4) == 0) ? 0x00 : 0xFF;
+        }
+
+        reference.clear();
+        for(i = 0; i < count; i++)
+        {
+            difference = actual[i] ^ (blank ? 0xFF : expected[i]);
+            if(masked)
+            {
+                difference &= careMask[i];
+            }
+            if(difference != 0)
+            {
+                reference.append(i);
+            }
+        }
+
+        mismatches.clear();
+        QCOMPARE(VerifyCompare(actual, blank ? 0 : expected, masked ? careMask : 0, count, &mismatches), (unsigned int)reference.count());
+        QCOMPARE(mismatches, reference);
+        QCOMPARE(VerifyCompare(actual, blank ? 0 : expected, masked ? careMask : 0, count, NULL), (unsigned int)reference.count());
+    }
+}
+
+void CoreTests::crc16()
+{
+    const unsigned char check[] = "123456789";
+
+    //CRC-16/CCITT-FALSE check value.
+    QCOMPARE(FirmwareBundle::Crc16(check, 9), (quint16)0x29B1);
+
+    //Chaining through the crc argument gives the CRC of the whole.
+    QCOMPARE(FirmwareBundle::Crc16(&check[4], 5, FirmwareBundle::Crc16(check, 4)), (quint16)0x29B1);
+    QCOMPARE(FirmwareBundle::Crc16(check, 0), (quint16)0xFFFF);
+}
+
+void CoreTests::firmwareBundle()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray flash = TestBytes(0x90, 13);
+    QByteArray eeprom = TestBytes(8, 14);
+    QByteArray file;
+    QString hexFileName = dir.path() + "/bundle.hex";
+    QString bundleFileName = dir.path() + "/test.lfb";
+    unsigned int address;
+
+    device.family = Device::PIC18;
+
+    file += HexRecord(HexImporter::DATA, TEST_FLASH_START + 0x130, flash);
+    file += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\xF0", 2));
+    file += HexRecord(HexImporter::DATA, TEST_EEPROM_START & 0xFFFF, eeprom);
+    file += HexRecord(HexImporter::END_OF_FILE, 0, QByteArray());
+    QCOMPARE(Import(hexFileName, file, &data, &device, import), HexImporter::Success);
+    QVERIFY(FirmwareBundle::Export(bundleFileName, &data, &device, import.hasConfigBits));
+    FreeRanges(&data);
+
+    //The bundle fills the buffers just as the hex file did.
+    AddTestLayout(&data);
+    QCOMPARE(import.ImportHexFile(bundleFileName, &data, &device), HexImporter::Success);
+    QVERIFY(import.hasEndOfFileRecord);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x130, flash.constData(), flash.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x12F], 0xFFu);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+
+    //The CRC of every erase page of flash it filled is handed on for verify.
+    QCOMPARE(data.pageCrcSize, (unsigned int)FirmwareBundle::DefaultPageSize);
+    QCOMPARE(data.pageCrcs.count(), 3);
+    for(address = TEST_FLASH_START + 0x100; address < (TEST_FLASH_START + 0x1C0); address += FirmwareBundle::DefaultPageSize)
+    {
+        QVERIFY(data.pageCrcs.contains(address));
+        QCOMPARE(data.pageCrcs.value(address), FirmwareBundle::Crc16(data.ranges[0].pDataBuffer + (address - TEST_FLASH_START), FirmwareBundle::DefaultPageSize));
+    }
+    FreeRanges(&data);
+
+    //Pages are the device's erase pages even where flash starts part way into one.  Only the whole
+    //pages get a CRC.
+    data.ranges.append(Range(PROGRAM_MEMORY, TEST_FLASH_START + 0x20, TEST_FLASH_END, 1));
+    QVERIFY(WriteFile(hexFileName, HexRecord(HexImporter::DATA, TEST_FLASH_START + 0x30, flash.left(0x70))));
+    QCOMPARE(import.ImportHexFile(hexFileName, &data, &device), HexImporter::Success);
+    QVERIFY(FirmwareBundle::Export(bundleFileName, &data, &device, false));
+    FreeRanges(&data);
+    data.ranges.append(Range(PROGRAM_MEMORY, TEST_FLASH_START + 0x20, TEST_FLASH_END, 1));
+    QCOMPARE(import.ImportHexFile(bundleFileName, &data, &device), HexImporter::Success);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x10, flash.constData(), 0x70) == 0);
+    QCOMPARE(data.pageCrcs.count(), 2);
+    for(address = TEST_FLASH_START + 0x40; address < (TEST_FLASH_START + 0xC0); address += FirmwareBundle::DefaultPageSize)
+    {
+        QVERIFY(data.pageCrcs.contains(address));
+        QCOMPARE(data.pageCrcs.value(address), FirmwareBundle::Crc16(data.ranges[0].pDataBuffer + (address - TEST_FLASH_START - 0x20), FirmwareBundle::DefaultPageSize));
+    }
+    FreeRanges(&data);
+
+    //A bundle laid out for another family is refused.
+    device.family = Device::PIC24;
+    AddTestLayout(&data);
+    QCOMPARE(import.ImportHexFile(bundleFileName, &data, &device), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+}
+
+void CoreTests::importIntelHex()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray flash = TestBytes(48, 8);
+    QByteArray eeprom = TestBytes(16, 9);
+    QByteArray dataRecord = HexRecord(HexImporter::DATA, TEST_FLASH_START + 0x40, flash.mid(32));
+    QByteArray endOfFile = HexRecord(HexImporter::END_OF_FILE, 0, QByteArray());
+    QByteArray body;
+    QByteArray broken;
+    QString fileName = dir.path() + "/test.hex";
+
+    device.family = Device::PIC18;
+
+    body += HexRecord(HexImporter::DATA, TEST_FLASH_START + 0x20, flash.left(32));
+    body += dataRecord;
+    body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\xF0", 2));
+    body += HexRecord(HexImporter::DATA, TEST_EEPROM_START & 0xFFFF, eeprom);
+    body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x30", 2));
+    body += HexRecord(HexImporter::DATA, TEST_CONFIG_START & 0xFFFF, QByteArray("\x11\x22", 2));
+
+    //A well formed file.
+    QCOMPARE(Import(fileName, body + endOfFile, &data, &device, import), HexImporter::Success);
+    QVERIFY(import.hasEndOfFileRecord);
+    QVERIFY(import.hasConfigBits);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x20, flash.constData(), flash.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x1F], 0xFFu);
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x20 + flash.size()], 0xFFu);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[2].pDataBuffer[0], 0x11u);
+    QCOMPARE(data.ranges[0].extents.count(), 1);
+    QCOMPARE(data.ranges[0].extents[0].start, (unsigned int)TEST_FLASH_START + 0x20);
+    QCOMPARE(data.ranges[0].extents[0].end, (unsigned int)TEST_FLASH_START + 0x20 + flash.size());
+    FreeRanges(&data);
+
+    //Without an end of file record the data is still imported, but the caller can tell.
+    QCOMPARE(Import(fileName, body, &data, &device, import), HexImporter::Success);
+    QVERIFY(!import.hasEndOfFileRecord);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x20, flash.constData(), flash.size()) == 0);
+    FreeRanges(&data);
+
+    //A bad checksum.
+    broken = dataRecord;
+    broken[broken.size() - 2] = (broken.at(broken.size() - 2) == '0') ? '1' : '0';
+    QCOMPARE(Import(fileName, broken + endOfFile, &data, &device, import), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+
+    //A character that isn't a hex digit.
+    broken = dataRecord;
+    broken[12] = 'G';
+    QCOMPARE(Import(fileName, broken + endOfFile, &data, &device, import), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+
+    //A line cut short of its byte count, and one too short to hold a record at all.
+    broken = dataRecord.left(dataRecord.size() - 5) + "\n";
+    QCOMPARE(Import(fileName, broken + endOfFile, &data, &device, import), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+    QCOMPARE(Import(fileName, QByteArray(":0000\n") + endOfFile, &data, &device, import), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+
+    //Data that lands outside every programmable region is not an error in the file, but there is nothing to program.
+    broken = HexRecord(HexImporter::DATA, TEST_FLASH_END + 0x100, flash);
+    broken += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x20", 2));
+    broken += HexRecord(HexImporter::DATA, 0, eeprom);
+    QCOMPARE(Import(fileName, broken + endOfFile, &data, &device, import), HexImporter::NoneInRange);
+    FreeRanges(&data);
+}
+
+void CoreTests::importIntelHexParallel()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray flash(TEST_FLASH_END - TEST_FLASH_START, (char)0xFF);
+    QByteArray eeprom(TEST_EEPROM_END - TEST_EEPROM_START, (char)0xFF);
+    QByteArray filler = TestBytes(16, 10);
+    QByteArray record;
+    QByteArray body;
+    QByteArray last;
+    QString fileName = dir.path() + "/large.hex";
+    unsigned int seed = 11;
+    unsigned int flashOffset = 0;
+    unsigned int eepromOffset = 0;
+    unsigned int offset;
+    int block;
+    int i;
+
+    device.family = Device::PIC18;
+
+    //Several MB of blocks.  Each block writes one record to the first half of flash or to EEPROM,
+    //at an address no other block touches, so no two slices overlap.  The rest of the block is
+    //filler, all at one address in the blank half of flash, but under an extended linear address
+    //with nothing behind it.  Nearly every slice starts inside the filler, so a slice that missed
+    //the type 04 record in the slice before it would write filler into the blank half.
+    for(block = 0; (flashOffset < (unsigned int)(flash.size() / 2)) || (eepromOffset < (unsigned int)eeprom.size()); block++)
+    {
+        record = TestBytes(16, NextRandom(&seed));
+        if((((block % 8) == 7) && (eepromOffset < (unsigned int)eeprom.size())) || (flashOffset >= (unsigned int)(flash.size() / 2)))
+        {
+            memcpy(eeprom.data() + eepromOffset, record.constData(), 16);
+            body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\xF0", 2));
+            body += HexRecord(HexImporter::DATA, (TEST_EEPROM_START + eepromOffset) & 0xFFFF, record);
+            eepromOffset += 16;
+        }
+        else
+        {
+            memcpy(flash.data() + flashOffset, record.constData(), 16);
+            body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x00", 2));
+            body += HexRecord(HexImporter::DATA, TEST_FLASH_START + flashOffset, record);
+            flashOffset += 16;
+        }
+
+        body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x01", 2));
+        for(i = 0; i < 256; i++)
+        {
+            body += HexRecord(HexImporter::DATA, TEST_FLASH_START + (flash.size() / 2) + (16 * (block % (flash.size() / 32))), filler);
+        }
+    }
+    body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x30", 2));
+    body += HexRecord(HexImporter::DATA, TEST_CONFIG_START & 0xFFFF, QByteArray("\x11\x22", 2));
+    QVERIFY(body.size() > (4 * 1024 * 1024));
+
+    //Every byte where a sequential import of the file would have put it.
+    QCOMPARE(Import(fileName, body + HexRecord(HexImporter::END_OF_FILE, 0, QByteArray()), &data, &device, import), HexImporter::Success);
+    QVERIFY(import.hasEndOfFileRecord);
+    QVERIFY(import.hasConfigBits);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer, flash.constData(), flash.size()) == 0);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[2].pDataBuffer[1], 0x22u);
+    QCOMPARE(data.ranges[0].extents.count(), 1);
+    QCOMPARE(data.ranges[0].extents[0].end, (unsigned int)TEST_FLASH_START + flashOffset);
+    FreeRanges(&data);
+
+    //A record near the end of the file rewrites bytes the first slice wrote.  The last record wins.
+    offset = 0x08;
+    last = TestBytes(16, 12);
+    memcpy(flash.data() + offset, last.constData(), 16);
+    body += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x00", 2));
+    body += HexRecord(HexImporter::DATA, TEST_FLASH_START + offset, last);
+    QCOMPARE(Import(fileName, body + HexRecord(HexImporter::END_OF_FILE, 0, QByteArray()), &data, &device, import), HexImporter::Success);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer, flash.constData(), flash.size()) == 0);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+    FreeRanges(&data);
+}
+
+void CoreTests::importSRecord()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray flash = TestBytes(100, 3);
+    QByteArray eeprom = TestBytes(8, 4);
+    QByteArray file;
+    QString fileName = dir.path() + "/test.s37";
+
+    device.family = Device::PIC18;
+    AddTestLayout(&data);
+
+    file += SRecord('0', 0, "test");
+    file += SRecord('3', TEST_FLASH_START + 0x40, flash.left(32));
+    file += SRecord('3', TEST_FLASH_START + 0x60, flash.mid(32));
+    file += SRecord('2', TEST_EEPROM_START, eeprom);
+    file += SRecord('3', TEST_CONFIG_START, QByteArray("\x11\x22", 2));
+    file += SRecord('7', 0, QByteArray());
+    QVERIFY(WriteFile(fileName, file));
+
+    QCOMPARE(import.ImportHexFile(fileName, &data, &device), HexImporter::Success);
+    QVERIFY(import.hasEndOfFileRecord);
+    QVERIFY(import.hasConfigBits);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x40, flash.constData(), flash.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x3F], 0xFFu);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[2].pDataBuffer[1], 0x22u);
+
+    QCOMPARE(data.ranges[0].extents.count(), 1);
+    QCOMPARE(data.ranges[0].extents[0].start, (unsigned int)TEST_FLASH_START + 0x40);
+    QCOMPARE(data.ranges[0].extents[0].end, (unsigned int)TEST_FLASH_START + 0x40 + flash.size());
+    QCOMPARE(data.ranges[1].extents.count(), 1);
+    QCOMPARE(data.ranges[1].extents[0].end, (unsigned int)TEST_EEPROM_START + eeprom.size());
+    FreeRanges(&data);
+
+    //A bad checksum is an error.
+    file[file.indexOf("\nS3") + 12] = (file.at(file.indexOf("\nS3") + 12) == '0') ? '1' : '0';
+    QVERIFY(WriteFile(fileName, file));
+    AddTestLayout(&data);
+    QCOMPARE(import.ImportHexFile(fileName, &data, &device), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+}
+
+void CoreTests::importElf()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray flash = TestBytes(0x90, 5);
+    QByteArray eeprom = TestBytes(16, 6);
+    QByteArray header(HexImporter::ELF_HEADER_SIZE, 0);
+    QByteArray programHeaders;
+    QByteArray contents;
+    QString fileName = dir.path() + "/test.elf";
+    quint32 segments[2][3] =
+    {
+        //p_paddr, p_filesz, p_memsz
+        { TEST_FLASH_START + 0x100, (quint32)flash.size(), (quint32)flash.size() + 0x20 },
+        { TEST_EEPROM_START, (quint32)eeprom.size(), (quint32)eeprom.size() }
+    };
+    quint32 offset = HexImporter::ELF_HEADER_SIZE + (2 * HexImporter::ELF_PROGRAM_HEADER_SIZE);
+    int i;
+
+    device.family = Device::PIC18;
+    AddTestLayout(&data);
+
+    //Little endian ELF32 headers, written a field at a time.
+    memcpy(header.data(), "\x7F" "ELF", 4);
+    header[HexImporter::ELF_CLASS] = HexImporter::ELF_CLASS_32;
+    header[HexImporter::ELF_DATA] = HexImporter::ELF_DATA_LSB;
+    header[HexImporter::ELF_MACHINE] = (char)HexImporter::ELF_EM_MCHP_PIC;
+    header[HexImporter::ELF_PHOFF] = HexImporter::ELF_HEADER_SIZE;
+    header[HexImporter::ELF_PHENTSIZE] = HexImporter::ELF_PROGRAM_HEADER_SIZE;
+    header[HexImporter::ELF_PHNUM] = 2;
+    for(i = 0; i < 2; i++)
+    {
+        QByteArray entry(HexImporter::ELF_PROGRAM_HEADER_SIZE, 0);
+        uchar* fields = (uchar*)entry.data();
+
+        qToLittleEndian((quint32)HexImporter::ELF_PT_LOAD, &fields[HexImporter::ELF_P_TYPE]);
+        qToLittleEndian(offset, &fields[HexImporter::ELF_P_OFFSET]);
+        qToLittleEndian(segments[i][0], &fields[HexImporter::ELF_P_PADDR]);
+        qToLittleEndian(segments[i][1], &fields[HexImporter::ELF_P_FILESZ]);
+        qToLittleEndian(segments[i][2], &fields[HexImporter::ELF_P_FILESZ + 4]);     //p_memsz
+        programHeaders += entry;
+        offset += segments[i][1];
+    }
+    contents = header + programHeaders + flash + eeprom;
+    QVERIFY(WriteFile(fileName, contents));
+
+    QCOMPARE(import.ImportHexFile(fileName, &data, &device), HexImporter::Success);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x100, flash.constData(), flash.size()) == 0);
+    //The .bss tail of a segment is not programmed.
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x100 + flash.size()], 0xFFu);
+    QVERIFY(memcmp(data.ranges[1].pDataBuffer, eeprom.constData(), eeprom.size()) == 0);
+    QCOMPARE(data.ranges[0].extents.count(), 1);
+    QCOMPARE(data.ranges[0].extents[0].end, (unsigned int)TEST_FLASH_START + 0x100 + flash.size());
+    FreeRanges(&data);
+
+    //Code built for another architecture is refused.
+    contents[HexImporter::ELF_MACHINE] = (char)HexImporter::ELF_EM_MIPS;
+    QVERIFY(WriteFile(fileName, contents));
+    AddTestLayout(&data);
+    QCOMPARE(import.ImportHexFile(fileName, &data, &device), HexImporter::ErrorInHexFile);
+    FreeRanges(&data);
+}
+
+void CoreTests::importBinary()
+{
+    DeviceData data;
+    Device device(&data);
+    HexImporter import;
+    QByteArray image = TestBytes(0x123, 7);
+    QString fileName = dir.path() + "/test.bin";
+
+    device.family = Device::PIC18;
+    AddTestLayout(&data);
+    QVERIFY(WriteFile(fileName, image));
+
+    import.binaryBaseAddress = TEST_FLASH_START + 0x80;
+    QCOMPARE(import.ImportHexFile(fileName, &data, &device), HexImporter::Success);
+    QVERIFY(memcmp(data.ranges[0].pDataBuffer + 0x80, image.constData(), image.size()) == 0);
+    QCOMPARE((unsigned int)data.ranges[0].pDataBuffer[0x7F], 0xFFu);
+    QCOMPARE(data.ranges[0].extents.count(), 1);
+    QCOMPARE(data.ranges[0].extents[0].start, (unsigned int)TEST_FLASH_START + 0x80);
+    QCOMPARE(data.ranges[0].extents[0].end, (unsigned int)TEST_FLASH_START + 0x80 + image.size());
+    QVERIFY(data.ranges[1].extents.isEmpty());
+
+    FreeRanges(&data);
+}
+
+QTEST_GUILESS_MAIN(CoreTests)
+
+#include "CoreTests.moc"
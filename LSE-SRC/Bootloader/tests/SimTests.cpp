@@ -0,0 +1,402 @@
+/************************************************************************
+* Copyright (c) 2009-2011,  Microchip Technology Inc.
+*
+* Microchip licenses this software to you solely for use with Microchip
+* products.  The software is owned by Microchip and its licensors, and
+* is protected under applicable copyright laws.  All rights reserved.
+*
+* SOFTWARE IS PROVIDED "AS IS."  MICROCHIP EXPRESSLY DISCLAIMS ANY
+* WARRANTY OF ANY KIND, WHETHER EXPRESS OR IMPLIED, INCLUDING BUT
+* NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS
+* FOR A PARTICULAR PURPOSE, OR NON-INFRINGEMENT.  IN NO EVENT SHALL
+* MICROCHIP BE LIABLE FOR ANY INCIDENTAL, SPECIAL, INDIRECT OR
+* CONSEQUENTIAL DAMAGES, LOST PROFITS OR LOST DATA, HARM TO YOUR
+* EQUIPMENT, COST OF PROCUREMENT OF SUBSTITUTE GOODS, TECHNOLOGY
+* OR SERVICES, ANY CLAIMS BY THIRD PARTIES (INCLUDING BUT NOT LIMITED
+* TO ANY DEFENSE THEREOF), ANY CLAIMS FOR INDEMNITY OR CONTRIBUTION,
+* OR OTHER SIMILAR COSTS.
+*
+* To the fullest extent allowed by law, Microchip and its licensors
+* liability shall not exceed the amount of fees, if any, that you
+* have paid directly to Microchip to use this software.
+*
+* MICROCHIP PROVIDES THIS SOFTWARE CONDITIONALLY UPON YOUR ACCEPTANCE
+* OF THESE TERMS.
+*
+************************************************************************/
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "../Comm.h"
+#include "../DeviceData.h"
+#include "../Device.h"
+#include "../FirmwareBundle.h"
+#include "../GangProgrammer.h"
+#include "../HexCache.h"
+#include "../ImportExportHex.h"
+#include "../Programmer.h"
+
+//Layout of the simulated part (see HIDAPI/sim/hid-sim.c).
+#define SIM_APP_START           0x1000
+#define SIM_EEPROM_ADDRESS      0xF00000
+#define SIM_SIGNATURE_ADDRESS   0x1006
+#define SIM_SIGNATURE_VALUE     0x600D
+
+/*!
+ * Programs the bootloader simulator end to end through Programmer, the way the
+ * GUI and the command line tool do.  Only built with CONFIG+=hidsim.
+ */
+class SimTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void writeVerifyDeltaVerify();
+    void deltaWriteSameImageTwice();
+    void verifyOverLossyBus();
+    void verifyCatchesCorruption();
+    void verifyBundleByPageCrc();
+
+private:
+    static QByteArray HexRecord(unsigned char type, unsigned int address, const QByteArray& data);
+    bool WriteImage(QString fileName, unsigned int seed);
+    static Comm::ErrorCode ReadSignature(Comm& comm, Device& device, unsigned int* signature);
+    void KeepDeviceState();
+    bool CorruptFlash(unsigned int address);
+
+    QTemporaryDir dir;
+};
+
+//Formats one Intel hex record.
+QByteArray SimTests::HexRecord(unsigned char type, unsigned int address, const QByteArray& data)
+{
+    QByteArray bytes;
+    unsigned char sum = 0;
+    int i;
+
+    bytes.append((char)data.size());
+    bytes.append((char)(address >> 8));
+    bytes.append((char)address);
+    bytes.append((char)type);
+    bytes.append(data);
+    for(i = 0; i < bytes.size(); i++)
+    {
+        sum += (unsigned char)bytes.at(i);
+    }
+    bytes.append((char)-sum);
+
+    return ":" + bytes.toHex().toUpper() + "\n";
+}
+
+//Writes an image of pseudo random data: two runs of flash with blank pages between them, and a
+//few bytes of EEPROM.  The signature word is left blank, as in a real application image.
+bool SimTests::WriteImage(QString fileName, unsigned int seed)
+{
+    QFile file(fileName);
+    QByteArray contents;
+    QByteArray data;
+    unsigned int address;
+    unsigned int i;
+
+    contents += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\x00", 2));
+    for(address = SIM_APP_START; address < (SIM_APP_START + 0x1000); address += 16)
+    {
+        if(address == (SIM_APP_START + 0x800))
+        {
+            address = SIM_APP_START + 0xC00;
+        }
+        data.clear();
+        for(i = 0; i < 16; i++)
+        {
+            seed = (seed * 1103515245) + 12345;
+            if(((address + i) == SIM_SIGNATURE_ADDRESS) || ((address + i) == (SIM_SIGNATURE_ADDRESS + 1)))
+            {
+                data.append((char)0xFF);
+            }
+            else
+            {
+                data.append((char)(seed >> 16));
+            }
+        }
+        contents += HexRecord(HexImporter::DATA, address, data);
+    }
+    contents += HexRecord(HexImporter::EXTENDED_LINEAR_ADDR, 0, QByteArray("\x00\xF0", 2));
+    contents += HexRecord(HexImporter::DATA, 0, QByteArray("\x01\x02\x03\x04\x05\x06\x07\x08", 8));
+    contents += HexRecord(HexImporter::END_OF_FILE, 0, QByteArray());
+
+    return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+}
+
+Comm::ErrorCode SimTests::ReadSignature(Comm& comm, Device& device, unsigned int* signature)
+{
+    unsigned char data[2];
+    Comm::ErrorCode result;
+
+    result = comm.GetData(SIM_SIGNATURE_ADDRESS, device.bytesPerPacket, device.bytesPerAddressFLASH,
+                          device.bytesPerWordFLASH, SIM_SIGNATURE_ADDRESS + 2, data);
+    *signature = data[0] | (data[1] << 8);
+    return result;
+}
+
+void SimTests::initTestCase()
+{
+    //No simulated bus or flash timing, and nothing carried over from earlier runs.
+    qputenv("HIDSIM_DEVICES", "1");
+    qputenv("HIDSIM_LATENCY_US", "0");
+    qputenv("HIDSIM_PROGRAM_US", "0");
+    qputenv("HIDSIM_ERASE_PAGE_US", "0");
+    qputenv("HIDSIM_LOSS", "0");
+    qunsetenv("HIDSIM_STATE_DIR");
+    HexCache::setEnabled(false);
+    QVERIFY(dir.isValid());
+}
+
+//Every test starts from a blank device.
+void SimTests::init()
+{
+    hid_exit();
+    hid_init();
+}
+
+//Back to a lossless bus and device memory that doesn't outlive the test.
+void SimTests::cleanup()
+{
+    qputenv("HIDSIM_LOSS", "0");
+    qunsetenv("HIDSIM_STATE_DIR");
+}
+
+//Restarts the simulator with a blank device whose memory is saved in dir when it is closed and
+//loaded again by the next hid_init(), so a test can change it between programming and verifying.
+void SimTests::KeepDeviceState()
+{
+    QFile::remove(dir.path() + "/hidsim0.bin");
+    qputenv("HIDSIM_STATE_DIR", QFile::encodeName(dir.path()));
+    hid_exit();
+    hid_init();
+}
+
+//Flips one bit of the saved flash of the simulated device, which must not be running.
+bool SimTests::CorruptFlash(unsigned int address)
+{
+    QFile file(dir.path() + "/hidsim0.bin");
+    char value;
+
+    if(!file.open(QIODevice::ReadWrite) || !file.seek(address) || !file.getChar(&value))
+    {
+        return false;
+    }
+    return file.seek(address) && file.putChar(value ^ 0x01);
+}
+
+//Program, verify the signed device, then write the same image again as a delta (which has
+//nothing to rewrite) and verify once more, by page CRC and by reading everything back.
+void SimTests::writeVerifyDeltaVerify()
+{
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    QString fileName = dir.path() + "/image.hex";
+    QStringList paths;
+    unsigned int signature;
+
+    QVERIFY(WriteImage(fileName, 1));
+    paths = GangProgrammer::Enumerate();
+    QCOMPARE(paths.count(), 1);
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.ImportHexFile(fileName, &hexData, import), HexImporter::Success);
+
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(ReadSignature(comm, device, &signature), Comm::Success);
+    QCOMPARE(signature, (unsigned int)SIM_SIGNATURE_VALUE);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+
+    programmer.deltaWrite = true;
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+    programmer.crcVerify = false;
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+    QCOMPARE(ReadSignature(comm, device, &signature), Comm::Success);
+    QCOMPARE(signature, (unsigned int)SIM_SIGNATURE_VALUE);
+
+    comm.close();
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+}
+
+//Two delta writes of the same image in a row: the second one finds every page, including the
+//signed one, already matching and must still verify without touching the device.
+void SimTests::deltaWriteSameImageTwice()
+{
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    QString fileName = dir.path() + "/same.hex";
+    QStringList paths;
+    unsigned int signature;
+
+    QVERIFY(WriteImage(fileName, 2));
+    paths = GangProgrammer::Enumerate();
+    QCOMPARE(paths.count(), 1);
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.ImportHexFile(fileName, &hexData, import), HexImporter::Success);
+
+    programmer.deltaWrite = true;
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(ReadSignature(comm, device, &signature), Comm::Success);
+    QCOMPARE(signature, (unsigned int)SIM_SIGNATURE_VALUE);
+    programmer.crcVerify = false;
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+
+    comm.close();
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+}
+
+//Verify with about one reply in twenty lost on the bus: GET_DATA requests whose replies go
+//missing are re-sent, and late duplicates are discarded, so both the full read back and the
+//page CRC verify still pass.  The seed is fixed, so every run loses the same replies.
+void SimTests::verifyOverLossyBus()
+{
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    QString fileName = dir.path() + "/lossy.hex";
+    QStringList paths;
+
+    QVERIFY(WriteImage(fileName, 3));
+    KeepDeviceState();
+    paths = GangProgrammer::Enumerate();
+    QCOMPARE(paths.count(), 1);
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.ImportHexFile(fileName, &hexData, import), HexImporter::Success);
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    comm.close();
+
+    qputenv("HIDSIM_LOSS", "0.05");
+    qputenv("HIDSIM_SEED", "7");
+    hid_exit();
+    hid_init();
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    programmer.crcVerify = false;
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+    programmer.crcVerify = true;
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+
+    comm.close();
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+}
+
+//A flash bit that changed after programming fails the verify, by page CRC and by full read
+//back, and the failing address is reported.
+void SimTests::verifyCatchesCorruption()
+{
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    QString fileName = dir.path() + "/corrupt.hex";
+    QStringList paths;
+    unsigned int address = SIM_APP_START + 0x123;
+
+    QVERIFY(WriteImage(fileName, 4));
+    KeepDeviceState();
+    paths = GangProgrammer::Enumerate();
+    QCOMPARE(paths.count(), 1);
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.ImportHexFile(fileName, &hexData, import), HexImporter::Success);
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    comm.close();
+
+    hid_exit();
+    QVERIFY(CorruptFlash(address));
+    hid_init();
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Fail);
+    QVERIFY(programmer.mismatchAddresses.contains(address));
+    programmer.crcVerify = false;
+    QCOMPARE(programmer.Verify(&hexData), Comm::Fail);
+    QVERIFY(programmer.mismatchAddresses.contains(address));
+
+    comm.close();
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+}
+
+//A firmware bundle exported for the device carries CRCs of its erase pages, which delta writes and
+//verify use instead of working them out.  They must still catch a flash bit that changed.
+void SimTests::verifyBundleByPageCrc()
+{
+    Comm comm;
+    DeviceData deviceData;
+    DeviceData hexData;
+    Device device(&deviceData);
+    Programmer programmer(&comm, &device, &deviceData);
+    HexImporter import;
+    QString fileName = dir.path() + "/bundle.hex";
+    QString bundleFileName = dir.path() + "/bundle.lfb";
+    QStringList paths;
+    unsigned int address = SIM_APP_START + 0x345;
+
+    QVERIFY(WriteImage(fileName, 5));
+    KeepDeviceState();
+    paths = GangProgrammer::Enumerate();
+    QCOMPARE(paths.count(), 1);
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QVERIFY(programmer.ErasePageSize() != 0);
+    QCOMPARE(programmer.ImportHexFile(fileName, &hexData, import), HexImporter::Success);
+    QVERIFY(FirmwareBundle::Export(bundleFileName, &hexData, &device, import.hasConfigBits, QByteArray(), programmer.ErasePageSize()));
+    QCOMPARE(programmer.ImportHexFile(bundleFileName, &hexData, import), HexImporter::Success);
+    QCOMPARE(hexData.pageCrcSize, programmer.ErasePageSize());
+    QVERIFY(hexData.pageCrcs.count() > 0);
+
+    programmer.deltaWrite = true;
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+    comm.close();
+
+    hid_exit();
+    QVERIFY(CorruptFlash(address));
+    hid_init();
+    QCOMPARE(comm.open(paths.first().toLocal8Bit().constData()), Comm::Success);
+    QCOMPARE(programmer.Query(), Comm::Success);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Fail);
+    QVERIFY(programmer.mismatchAddresses.contains(address));
+
+    //A delta write puts the page right again.
+    QCOMPARE(programmer.Write(&hexData), Comm::Success);
+    QCOMPARE(programmer.Verify(&hexData), Comm::Success);
+
+    comm.close();
+    Programmer::FreeRanges(&deviceData);
+    Programmer::FreeRanges(&hexData);
+}
+
+QTEST_GUILESS_MAIN(SimTests)
+
+#include "SimTests.moc"
@@ -10,9 +10,16 @@ HEADERS += hidapi.h
 # -------------------------------------------------
 # Add appropriate source file depending on OS
 # -------------------------------------------------
-macx:  SOURCES += mac/hid.c
-unix: !macx:  SOURCES += linux/hid-libusb.c
-win32: SOURCES += windows/hid.cpp
+# Build with "qmake CONFIG+=hidsim" to replace the
+# real backend with the bootloader simulator
+# -------------------------------------------------
+hidsim {
+    SOURCES += sim/hid-sim.c
+} else {
+    macx:  SOURCES += mac/hid.c
+    unix: !macx:  SOURCES += linux/hid-libusb.c
+    win32: SOURCES += windows/hid.cpp
+}
 
 # -------------------------------------------------
 # Make sure output directory for object file and
@@ -39,3 +46,10 @@ win32 {
     UI_DIR = windows
     RCC_DIR = windows
 }
+hidsim {
+    DESTDIR = sim
+    OBJECTS_DIR = sim
+    MOC_DIR = sim
+    UI_DIR = sim
+    RCC_DIR = sim
+}
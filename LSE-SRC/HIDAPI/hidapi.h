@@ -200,6 +200,43 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_write(hid_device *device, const unsigned char *data, size_t length);
 
+		/** @brief Queue an Output report without waiting for it to be sent.
+
+			Works like hid_write(), but returns as soon as the report
+			has been handed to the USB stack, so several reports can be
+			in flight at once. If @p max_pending writes are already
+			outstanding, this call blocks until one of them completes.
+			Reports are sent in the order they were queued. Backends
+			without asynchronous write support fall back to hid_write().
+
+			A failure of an earlier queued write is reported by the next
+			call to hid_write_async() or hid_write_flush().
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+			@param data The data to send, including the report number as
+				the first byte.
+			@param length The length in bytes of the data to send.
+			@param max_pending The maximum number of writes allowed in
+				flight at once.
+
+			@returns
+				This function returns the number of bytes queued and
+				-1 on error.
+		*/
+		int  HID_API_EXPORT HID_API_CALL hid_write_async(hid_device *device, const unsigned char *data, size_t length, int max_pending);
+
+		/** @brief Wait for all writes queued with hid_write_async().
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+
+			@returns
+				This function returns 0 once every queued write has
+				completed successfully and -1 if any of them failed.
+		*/
+		int  HID_API_EXPORT HID_API_CALL hid_write_flush(hid_device *device);
+
 		/** @brief Read an Input report from a HID device with timeout.
 
 			Input reports are returned
@@ -259,6 +296,22 @@ extern "C" {
 		*/
 		int  HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *device, int nonblock);
 
+		/** @brief Get the number of Input reports dropped by the library.
+
+			Backends that buffer Input reports internally drop new
+			reports when the buffer is full and the application isn't
+			reading fast enough. This returns how many were dropped
+			since the device was opened. Backends that don't buffer
+			reports always return 0.
+
+			@ingroup API
+			@param device A device handle returned from hid_open().
+
+			@returns
+				The number of Input reports dropped.
+		*/
+		unsigned long HID_API_EXPORT HID_API_CALL hid_get_input_overflow(hid_device *device);
+
 		/** @brief Send a Feature report to the device.
 
 			Feature reports are sent over the Control endpoint as a
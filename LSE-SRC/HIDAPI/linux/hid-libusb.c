@@ -29,6 +29,7 @@
 #include <ctype.h>
 #include <locale.h>
 #include <errno.h>
+#include <time.h>
 
 /* Unix */
 #include <unistd.h>
@@ -55,13 +56,25 @@ extern "C" {
 #define LOG(...) do {} while (0)
 #endif
 
-/* Linked List of input reports received from the device. */
+/* Input reports received from the device are kept in a fixed size,
+   single producer/single consumer ring: read_callback() fills slots on
+   the event thread and hid_read() empties them, without taking a lock.
+   Number of input reports buffered per device. Must be a power of two. */
+#define INPUT_RING_SLOTS 64
+
+/* One slot of the input report ring. data points into the single
+   block allocated for the ring when the device is opened. */
 struct input_report {
 	uint8_t *data;
 	size_t len;
-	struct input_report *next;
 };
 
+/* Upper bound on the window passed to hid_write_async(). */
+#define MAX_PENDING_WRITES 32
+
+/* Largest report (including the report ID) hid_write_async() can queue. */
+#define MAX_WRITE_REPORT_SIZE 65
+
 
 struct hid_device_ {
 	/* Handle to the actual device. */
@@ -83,22 +96,48 @@ struct hid_device_ {
 	/* Whether blocking reads are used */
 	int blocking; /* boolean */
 	
-	/* Read thread objects */
-	pthread_t thread;
-	pthread_mutex_t mutex; /* Protects input_reports */
+	/* Read objects. Completions are delivered on the shared
+	   event_thread(), which hands them to this device. */
+	pthread_mutex_t mutex; /* Protects the sleep/wake handshake with readers */
 	pthread_cond_t condition;
-	pthread_barrier_t barrier; /* Ensures correct startup sequence */
-	int shutdown_thread;
+	int shutdown_thread; /* Device closing or gone; no more resubmits */
+	int transfer_done; /* read_callback() won't resubmit the transfer */
 	struct libusb_transfer *transfer;
 
-	/* List of received input reports. */
-	struct input_report *input_reports;
+	/* Ring of received input reports. read_callback() is the only
+	   producer and advances input_head; the reader is the only consumer
+	   and advances input_tail. Both are free running counters. */
+	struct input_report input_reports[INPUT_RING_SLOTS];
+	uint8_t *input_buffer;
+	unsigned int input_head;
+	unsigned int input_tail;
+	int input_waiting; /* A reader is (about to be) asleep on condition */
+	unsigned long input_overflow; /* Reports dropped because the ring was full */
+
+	/* Asynchronous OUT transfers used by hid_write_async(). They are
+	   allocated on first use and protected by mutex. */
+	struct libusb_transfer *write_transfers[MAX_PENDING_WRITES];
+	int write_busy[MAX_PENDING_WRITES];
+	int writes_pending;
+	int write_error;
+	pthread_cond_t write_condition;
 };
 
-static int initialized = 0;
+/* One libusb context and one event handling thread serve every open
+   device. The thread runs while at least one device is open. */
+static libusb_context *usb_context = NULL;
+static pthread_mutex_t event_thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t event_thread_id;
+static int event_thread_refs = 0;
+static int event_thread_shutdown = 0;
+
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+#define HAVE_LIBUSB_INTERRUPT_EVENT_HANDLER 1
+#endif
 
 uint16_t get_usb_code_for_current_locale(void);
 static int return_data(hid_device *dev, unsigned char *data, size_t length);
+static int input_ring_empty(hid_device *dev);
 
 static hid_device *new_hid_device(void)
 {
@@ -113,12 +152,17 @@ static hid_device *new_hid_device(void)
 	dev->serial_index = 0;
 	dev->blocking = 1;
 	dev->shutdown_thread = 0;
+	dev->transfer_done = 1;
 	dev->transfer = NULL;
-	dev->input_reports = NULL;
+	dev->input_buffer = NULL;
+	dev->input_head = 0;
+	dev->input_tail = 0;
+	dev->input_waiting = 0;
+	dev->input_overflow = 0;
 	
 	pthread_mutex_init(&dev->mutex, NULL);
 	pthread_cond_init(&dev->condition, NULL);
-	pthread_barrier_init(&dev->barrier, NULL, 2);
+	pthread_cond_init(&dev->write_condition, NULL);
 	
 	return dev;
 }
@@ -126,10 +170,12 @@ static hid_device *new_hid_device(void)
 static void free_hid_device(hid_device *dev)
 {
 	/* Clean up the thread objects */
-	pthread_barrier_destroy(&dev->barrier);
+	pthread_cond_destroy(&dev->write_condition);
 	pthread_cond_destroy(&dev->condition);
 	pthread_mutex_destroy(&dev->mutex);
 
+	free(dev->input_buffer);
+
 	/* Free the device itself */
 	free(dev);
 }
@@ -264,6 +310,28 @@ static char *make_path(libusb_device *dev, int interface_number)
 	return strdup(str);
 }
 
+int HID_API_EXPORT hid_init(void)
+{
+	if (!usb_context) {
+		if (libusb_init(&usb_context) < 0) {
+			usb_context = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	if (usb_context) {
+		libusb_exit(usb_context);
+		usb_context = NULL;
+	}
+
+	return 0;
+}
+
 struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
 {
 	libusb_device **devs;
@@ -277,12 +345,10 @@ struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id,
 	
 	setlocale(LC_ALL,"");
 	
-	if (!initialized) {
-		libusb_init(NULL);
-		initialized = 1;
-	}
+	if (hid_init() < 0)
+		return NULL;
 	
-	num_devs = libusb_get_device_list(NULL, &devs);
+	num_devs = libusb_get_device_list(usb_context, &devs);
 	if (num_devs < 0)
 		return NULL;
 	while ((dev = devs[i++]) != NULL) {
@@ -425,46 +491,44 @@ static void read_callback(struct libusb_transfer *transfer)
 	hid_device *dev = transfer->user_data;
 	
 	if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
-
-		struct input_report *rpt = malloc(sizeof(*rpt));
-		rpt->data = malloc(transfer->actual_length);
-		memcpy(rpt->data, transfer->buffer, transfer->actual_length);
-		rpt->len = transfer->actual_length;
-		rpt->next = NULL;
-
-		pthread_mutex_lock(&dev->mutex);
-
-		/* Attach the new report object to the end of the list. */
-		if (dev->input_reports == NULL) {
-			/* The list is empty. Put it at the root. */
-			dev->input_reports = rpt;
-			pthread_cond_signal(&dev->condition);
+		unsigned int head = dev->input_head;
+		unsigned int tail = __atomic_load_n(&dev->input_tail, __ATOMIC_ACQUIRE);
+
+		if (head - tail >= INPUT_RING_SLOTS) {
+			/* The reader isn't keeping up. Count the report instead
+			   of growing without bound; hid_get_input_overflow()
+			   makes the loss visible to the application. */
+			__atomic_add_fetch(&dev->input_overflow, 1, __ATOMIC_RELAXED);
+			LOG("Input report ring full, report dropped\n");
 		}
 		else {
-			/* Find the end of the list and attach. */
-			struct input_report *cur = dev->input_reports;
-			int num_queued = 0;
-			while (cur->next != NULL) {
-				cur = cur->next;
-				num_queued++;
+			struct input_report *rpt = &dev->input_reports[head % INPUT_RING_SLOTS];
+			memcpy(rpt->data, transfer->buffer, transfer->actual_length);
+			rpt->len = transfer->actual_length;
+
+			/* Publish the slot. The sequentially consistent store
+			   pairs with the one in hid_read_timeout(): either the
+			   reader sees the new head before sleeping, or we see
+			   input_waiting and wake it up. */
+			__atomic_store_n(&dev->input_head, head + 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&dev->input_waiting, __ATOMIC_SEQ_CST)) {
+				pthread_mutex_lock(&dev->mutex);
+				pthread_cond_signal(&dev->condition);
+				pthread_mutex_unlock(&dev->mutex);
 			}
-			cur->next = rpt;
-			
-			/* Pop one off if we've reached 30 in the queue. This
-			   way we don't grow forever if the user never reads
-			   anything from the device. */
-			if (num_queued > 30) {
-				return_data(dev, NULL, 0);
-			}			
 		}
-		pthread_mutex_unlock(&dev->mutex);
-	}
-	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
-		dev->shutdown_thread = 1;
-		return;
 	}
-	else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+	else if (transfer->status == LIBUSB_TRANSFER_CANCELLED ||
+	         transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+		/* Wake up any reader sleeping in hid_read_timeout(), so
+		   it can return an error instead of waiting forever, and
+		   hid_close(), which waits for the transfer to come back. */
+		pthread_mutex_lock(&dev->mutex);
 		dev->shutdown_thread = 1;
+		dev->transfer_done = 1;
+		pthread_cond_broadcast(&dev->condition);
+		pthread_cond_broadcast(&dev->write_condition);
+		pthread_mutex_unlock(&dev->mutex);
 		return;
 	}
 	else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
@@ -474,75 +538,109 @@ static void read_callback(struct libusb_transfer *transfer)
 		LOG("Unknown transfer code: %d\n", transfer->status);
 	}
 	
-	/* Re-submit the transfer object. */
-	libusb_submit_transfer(transfer);
+	/* Re-submit the transfer object, unless hid_close() got in
+	   between. Both sides hold the mutex, so hid_close() either sees
+	   the resubmitted transfer and cancels it, or we see the flag. */
+	pthread_mutex_lock(&dev->mutex);
+	if (dev->shutdown_thread || libusb_submit_transfer(transfer) < 0) {
+		dev->shutdown_thread = 1;
+		dev->transfer_done = 1;
+		pthread_cond_broadcast(&dev->condition);
+		pthread_cond_broadcast(&dev->write_condition);
+	}
+	pthread_mutex_unlock(&dev->mutex);
 }
 
 
-static void *read_thread(void *param)
+static void *event_thread(void *param)
 {
-	hid_device *dev = param;
-	unsigned char *buf;
-	const size_t length = dev->input_ep_max_packet_size;
-
-	/* Set up the transfer object. */
-	buf = malloc(length);
-	dev->transfer = libusb_alloc_transfer(0);
-	libusb_fill_interrupt_transfer(dev->transfer,
-		dev->device_handle,
-		dev->input_endpoint,
-		buf,
-		length,
-		read_callback,
-		dev,
-		5000/*timeout*/);
-	
-	/* Make the first submission. Further submissions are made
-	   from inside read_callback() */
-	libusb_submit_transfer(dev->transfer);
-
-	// Notify the main thread that the read thread is up and running.
-	pthread_barrier_wait(&dev->barrier);
-	
-	/* Handle all the events. */
-	while (!dev->shutdown_thread) {
+	/* Handle the events of every open device. This sleeps until some
+	   transfer completes, so idle devices cost no CPU; completions are
+	   dispatched through the transfer callbacks to the device they
+	   belong to. */
+	while (!event_thread_shutdown) {
 		int res;
+#ifdef HAVE_LIBUSB_INTERRUPT_EVENT_HANDLER
+		res = libusb_handle_events_completed(usb_context, &event_thread_shutdown);
+#else
+		/* Without libusb_interrupt_event_handler() there is no way
+		   to wake the loop for shutdown, so bound the sleep. */
 		struct timeval tv;
-
-		tv.tv_sec = 0;
-		tv.tv_usec = 100; //TODO: Fix this value.
-		res = libusb_handle_events_timeout(NULL, &tv);
-		if (res < 0) {
+		tv.tv_sec = 1;
+		tv.tv_usec = 0;
+		res = libusb_handle_events_timeout_completed(usb_context, &tv, &event_thread_shutdown);
+#endif
+		if (res < 0 && res != LIBUSB_ERROR_INTERRUPTED) {
 			/* There was an error. Break out of this loop. */
+			LOG("libusb event handling failed: %d\n", res);
 			break;
 		}
 	}
-	
-	/* Cancel any transfer that may be pending. This call will fail
-	   if no transfers are pending, but that's OK. */
-	if (libusb_cancel_transfer(dev->transfer) == 0) {
-		/* The transfer was cancelled, so wait for its completion. */
-		libusb_handle_events(NULL);
-	}
 
-	/* The dev->transfer->buffer and dev->transfer objects are cleaned up
-	   in hid_close(). They are not cleaned up here because this thread
-	   could end either due to a disconnect or due to a user
-	   call to hid_close(). In both cases the objects can be safely
-	   cleaned up after the call to pthread_join() (in hid_close()), but
-	   since hid_close() calls libusb_cancel_transfer(), on these objects,
-	   they can not be cleaned up here. */
-	
 	return NULL;
 }
 
+/* Start event_thread() for the first open device. */
+static int event_thread_acquire(void)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&event_thread_mutex);
+	if (event_thread_refs == 0) {
+		event_thread_shutdown = 0;
+		if (pthread_create(&event_thread_id, NULL, event_thread, NULL) != 0)
+			res = -1;
+	}
+	if (res == 0)
+		event_thread_refs++;
+	pthread_mutex_unlock(&event_thread_mutex);
+
+	return res;
+}
+
+/* Stop event_thread() once the last device has been closed. */
+static void event_thread_release(void)
+{
+	pthread_mutex_lock(&event_thread_mutex);
+	if (--event_thread_refs == 0) {
+		event_thread_shutdown = 1;
+#ifdef HAVE_LIBUSB_INTERRUPT_EVENT_HANDLER
+		libusb_interrupt_event_handler(usb_context);
+#endif
+		pthread_join(event_thread_id, NULL);
+	}
+	pthread_mutex_unlock(&event_thread_mutex);
+}
+
+/* Cancel the device's transfers and wait for event_thread() to hand
+   them back. After this returns no callback will touch dev. */
+static void cancel_transfers(hid_device *dev)
+{
+	int i;
+
+	pthread_mutex_lock(&dev->mutex);
+
+	dev->shutdown_thread = 1;
+	if (!dev->transfer_done)
+		libusb_cancel_transfer(dev->transfer);
+	for (i = 0; i < MAX_PENDING_WRITES; i++) {
+		if (dev->write_busy[i])
+			libusb_cancel_transfer(dev->write_transfers[i]);
+	}
+
+	while (!dev->transfer_done)
+		pthread_cond_wait(&dev->condition, &dev->mutex);
+	while (dev->writes_pending > 0)
+		pthread_cond_wait(&dev->write_condition, &dev->mutex);
+
+	pthread_mutex_unlock(&dev->mutex);
+}
+
 
 hid_device * HID_API_EXPORT hid_open_path(const char *path)
 {
 	hid_device *dev = NULL;
 
-	dev = new_hid_device();
-
 	libusb_device **devs;
 	libusb_device *usb_dev;
     //ssize_t num_devs;
@@ -552,12 +650,12 @@ hid_device * HID_API_EXPORT hid_open_path(const char *path)
 	
 	setlocale(LC_ALL,"");
 	
-	if (!initialized) {
-		libusb_init(NULL);
-		initialized = 1;
-	}
+	if (hid_init() < 0)
+		return NULL;
+
+	dev = new_hid_device();
 	
-    libusb_get_device_list(NULL, &devs);
+    libusb_get_device_list(usb_context, &devs);
 
 	while ((usb_dev = devs[d++]) != NULL) {
 		struct libusb_device_descriptor desc;
@@ -637,10 +735,49 @@ hid_device * HID_API_EXPORT hid_open_path(const char *path)
 							}
 						}
 						
-						pthread_create(&dev->thread, NULL, read_thread, dev);
-						
-						// Wait here for the read thread to be initialized.
-						pthread_barrier_wait(&dev->barrier);
+						/* Carve the input report ring out of one block, so
+						   read_callback() never has to allocate. */
+						dev->input_buffer = malloc(INPUT_RING_SLOTS * dev->input_ep_max_packet_size);
+						if (dev->input_buffer == NULL) {
+							LOG("can't allocate input report ring\n");
+							libusb_release_interface(dev->device_handle, dev->interface);
+							libusb_close(dev->device_handle);
+							good_open = 0;
+							break;
+						}
+						for (i = 0; i < INPUT_RING_SLOTS; i++) {
+							dev->input_reports[i].data = dev->input_buffer + i * dev->input_ep_max_packet_size;
+							dev->input_reports[i].len = 0;
+						}
+
+						/* Input reports are received by the shared event
+						   thread, which must be running before the first
+						   read transfer is submitted. */
+						if (event_thread_acquire() < 0) {
+							LOG("can't start event thread\n");
+							libusb_release_interface(dev->device_handle, dev->interface);
+							libusb_close(dev->device_handle);
+							good_open = 0;
+							break;
+						}
+
+						/* Set up the transfer object. Further submissions
+						   are made from inside read_callback() */
+						dev->transfer = libusb_alloc_transfer(0);
+						libusb_fill_interrupt_transfer(dev->transfer,
+							dev->device_handle,
+							dev->input_endpoint,
+							malloc(dev->input_ep_max_packet_size),
+							dev->input_ep_max_packet_size,
+							read_callback,
+							dev,
+							5000/*timeout*/);
+						dev->transfer_done = 0;
+						if (libusb_submit_transfer(dev->transfer) < 0) {
+							LOG("can't submit read transfer\n");
+							dev->transfer_done = 1;
+							dev->shutdown_thread = 1;
+						}
 						
 					}
 					free(dev_path);
@@ -715,24 +852,163 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 	}
 }
 
+
+static void write_callback(struct libusb_transfer *transfer)
+{
+	hid_device *dev = transfer->user_data;
+	int i;
+
+	pthread_mutex_lock(&dev->mutex);
+
+	if (transfer->status != LIBUSB_TRANSFER_COMPLETED ||
+	    transfer->actual_length != transfer->length) {
+		LOG("Queued write failed: %d\n", transfer->status);
+		dev->write_error = 1;
+	}
+
+	/* Give the transfer back to the pool. */
+	for (i = 0; i < MAX_PENDING_WRITES; i++) {
+		if (dev->write_transfers[i] == transfer) {
+			dev->write_busy[i] = 0;
+			break;
+		}
+	}
+	dev->writes_pending--;
+	pthread_cond_broadcast(&dev->write_condition);
+
+	pthread_mutex_unlock(&dev->mutex);
+}
+
+int HID_API_EXPORT hid_write_async(hid_device *dev, const unsigned char *data, size_t length, int max_pending)
+{
+	struct libusb_transfer *transfer = NULL;
+	int report_number = data[0];
+	int skipped_report_id = 0;
+	int res;
+	int i;
+
+	if (report_number == 0x0) {
+		data++;
+		length--;
+		skipped_report_id = 1;
+	}
+
+	/* Control endpoint writes and oversized reports stay synchronous. */
+	if (dev->output_endpoint <= 0 || length > MAX_WRITE_REPORT_SIZE) {
+		if (skipped_report_id) {
+			data--;
+			length++;
+		}
+		return hid_write(dev, data, length);
+	}
+
+	if (max_pending < 1)
+		max_pending = 1;
+	if (max_pending > MAX_PENDING_WRITES)
+		max_pending = MAX_PENDING_WRITES;
+
+	pthread_mutex_lock(&dev->mutex);
+
+	/* Wait for room in the window. */
+	while (dev->writes_pending >= max_pending &&
+	       !dev->write_error && !dev->shutdown_thread) {
+		pthread_cond_wait(&dev->write_condition, &dev->mutex);
+	}
+
+	if (dev->write_error || dev->shutdown_thread) {
+		/* An earlier write failed, or the device went away. */
+		dev->write_error = 0;
+		pthread_mutex_unlock(&dev->mutex);
+		return -1;
+	}
+
+	/* Find a free transfer, allocating the pool slot on first use. */
+	for (i = 0; i < MAX_PENDING_WRITES; i++) {
+		if (!dev->write_busy[i])
+			break;
+	}
+	if (dev->write_transfers[i] == NULL) {
+		dev->write_transfers[i] = libusb_alloc_transfer(0);
+		if (dev->write_transfers[i] == NULL) {
+			pthread_mutex_unlock(&dev->mutex);
+			return -1;
+		}
+		dev->write_transfers[i]->buffer = malloc(MAX_WRITE_REPORT_SIZE);
+	}
+	transfer = dev->write_transfers[i];
+	dev->write_busy[i] = 1;
+	dev->writes_pending++;
+
+	memcpy(transfer->buffer, data, length);
+	libusb_fill_interrupt_transfer(transfer,
+		dev->device_handle,
+		dev->output_endpoint,
+		transfer->buffer,
+		length,
+		write_callback,
+		dev,
+		5000/*timeout*/);
+
+	/* Submit with the mutex held, so the callback can not run
+	   before the bookkeeping above is consistent. */
+	res = libusb_submit_transfer(transfer);
+	if (res < 0) {
+		dev->write_busy[i] = 0;
+		dev->writes_pending--;
+		pthread_mutex_unlock(&dev->mutex);
+		return -1;
+	}
+
+	pthread_mutex_unlock(&dev->mutex);
+
+	if (skipped_report_id)
+		length++;
+
+	return length;
+}
+
+int HID_API_EXPORT hid_write_flush(hid_device *dev)
+{
+	int res = 0;
+
+	pthread_mutex_lock(&dev->mutex);
+
+	while (dev->writes_pending > 0 && !dev->shutdown_thread) {
+		pthread_cond_wait(&dev->write_condition, &dev->mutex);
+	}
+
+	if (dev->write_error || dev->writes_pending > 0)
+		res = -1;
+	dev->write_error = 0;
+
+	pthread_mutex_unlock(&dev->mutex);
+
+	return res;
+}
+
+static int input_ring_empty(hid_device *dev)
+{
+	return __atomic_load_n(&dev->input_head, __ATOMIC_SEQ_CST) == dev->input_tail;
+}
+
 /* Helper function, to simplify hid_read().
-   This should be called with dev->mutex locked. */
+   Pops the oldest report off the ring. Only the reading thread may
+   call this, and only when the ring is not empty. */
 static int return_data(hid_device *dev, unsigned char *data, size_t length)
 {
-	/* Copy the data out of the linked list item (rpt) into the
-	   return buffer (data), and delete the liked list item. */
-	struct input_report *rpt = dev->input_reports;
+	unsigned int tail = dev->input_tail;
+	struct input_report *rpt = &dev->input_reports[tail % INPUT_RING_SLOTS];
 	size_t len = (length < rpt->len)? length: rpt->len;
 	if (len > 0)
 		memcpy(data, rpt->data, len);
-	dev->input_reports = rpt->next;
-	free(rpt->data);
-	free(rpt);
+
+	/* Hand the slot back to read_callback(). */
+	__atomic_store_n(&dev->input_tail, tail + 1, __ATOMIC_RELEASE);
 	return len;
 }
 
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
 {
 	int bytes_read = -1;
 
@@ -743,36 +1019,66 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 	return transferred;
 #endif
 
+	/* There's an input report queued up. Return it without
+	   touching the mutex. */
+	if (!input_ring_empty(dev))
+		return return_data(dev, data, length);
+
+	if (milliseconds == 0)
+		return (dev->shutdown_thread)? -1: 0;
+
 	pthread_mutex_lock(&dev->mutex);
 
-	/* There's an input report queued up. Return it. */
-	if (dev->input_reports) {
-		/* Return the first one */
-		bytes_read = return_data(dev, data, length);
-		goto ret;
+	/* Tell read_callback() to wake us, then look at the ring once
+	   more in case a report was published in the meantime. */
+	__atomic_store_n(&dev->input_waiting, 1, __ATOMIC_SEQ_CST);
+
+	if (milliseconds == -1) {
+		/* Blocking. read_callback() signals the condition when
+		   a report is queued or the device goes away. */
+		while (input_ring_empty(dev) && !dev->shutdown_thread)
+			pthread_cond_wait(&dev->condition, &dev->mutex);
 	}
-	
-	if (dev->shutdown_thread) {
-		/* This means the device has been disconnected.
-		   An error code of -1 should be returned. */
-		bytes_read = -1;
-		goto ret;
+	else if (milliseconds > 0) {
+		/* Sleep until a report arrives or the timeout expires. */
+		int res = 0;
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += milliseconds / 1000;
+		ts.tv_nsec += (milliseconds % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+
+		while (input_ring_empty(dev) && !dev->shutdown_thread && res == 0)
+			res = pthread_cond_timedwait(&dev->condition, &dev->mutex, &ts);
 	}
-	
-	if (dev->blocking) {
-		pthread_cond_wait(&dev->condition, &dev->mutex);
+
+	__atomic_store_n(&dev->input_waiting, 0, __ATOMIC_SEQ_CST);
+
+	if (!input_ring_empty(dev))
 		bytes_read = return_data(dev, data, length);
-	}
-	else {
-		bytes_read = 0;
-	}
+	else if (dev->shutdown_thread)
+		bytes_read = -1;
+	else
+		bytes_read = 0; /* Timed out */
 
-ret:
 	pthread_mutex_unlock(&dev->mutex);
 
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
+}
+
+unsigned long HID_API_EXPORT hid_get_input_overflow(hid_device *dev)
+{
+	return __atomic_load_n(&dev->input_overflow, __ATOMIC_RELAXED);
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	dev->blocking = !nonblock;
@@ -847,16 +1153,26 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	if (!dev)
 		return;
 	
-	/* Cause read_thread() to stop. */
-	dev->shutdown_thread = 1;
-	libusb_cancel_transfer(dev->transfer);
-
-	/* Wait for read_thread() to end. */
-	pthread_join(dev->thread, NULL);
+	/* Take the device's transfers back from the event thread, then
+	   let the thread go if this was the last open device. */
+	cancel_transfers(dev);
+	event_thread_release();
 	
-	/* Clean up the Transfer objects allocated in read_thread(). */
+	/* Clean up the Transfer objects allocated in hid_open_path(). */
 	free(dev->transfer->buffer);
 	libusb_free_transfer(dev->transfer);
+
+	/* ...and the ones allocated by hid_write_async(). cancel_transfers()
+	   has waited for all of them to complete. */
+	{
+		int i;
+		for (i = 0; i < MAX_PENDING_WRITES; i++) {
+			if (dev->write_transfers[i]) {
+				free(dev->write_transfers[i]->buffer);
+				libusb_free_transfer(dev->write_transfers[i]);
+			}
+		}
+	}
 	
 	/* release the interface */
 	libusb_release_interface(dev->device_handle, dev->interface);
@@ -864,13 +1180,7 @@ void HID_API_EXPORT hid_close(hid_device *dev)
 	/* Close the handle */
 	libusb_close(dev->device_handle);
 	
-	/* Clear out the queue of received reports. */
-	pthread_mutex_lock(&dev->mutex);
-	while (dev->input_reports) {
-		return_data(dev, NULL, 0);
-	}
-	pthread_mutex_unlock(&dev->mutex);
-	
+	/* The report ring is released along with the device. */
 	free_hid_device(dev);
 }
 
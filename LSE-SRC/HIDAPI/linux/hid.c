@@ -35,6 +35,7 @@
 #include <sys/ioctl.h>
 #include <sys/utsname.h>
 #include <fcntl.h>
+#include <poll.h>
 
 /* Linux */
 #include <linux/hidraw.h>
@@ -194,6 +195,17 @@ end:
 }
 
 
+/* hidraw keeps no library-wide state, so there is nothing to set up or tear down. */
+int HID_API_EXPORT hid_init(void)
+{
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	return 0;
+}
+
 struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
 {
 	struct udev *udev;
@@ -429,10 +441,47 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
 }
 
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+/* This backend has no queued write path; every write completes
+   before returning, so there is never anything left to flush. */
+int HID_API_EXPORT hid_write_async(hid_device *dev, const unsigned char *data, size_t length, int max_pending)
+{
+	return hid_write(dev, data, length);
+}
+
+int HID_API_EXPORT hid_write_flush(hid_device *dev)
+{
+	return 0;
+}
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
 {
 	int bytes_read;
 
+	if (milliseconds != 0) {
+		/* milliseconds is -1 or > 0. In both cases, sleep in poll()
+		   until a report is available. -1 means wait forever. */
+		int ret;
+		struct pollfd fds;
+
+		fds.fd = dev->device_handle;
+		fds.events = POLLIN;
+		fds.revents = 0;
+		ret = poll(&fds, 1, milliseconds);
+		if (ret == 0) {
+			/* Timeout */
+			return 0;
+		}
+		if (ret == -1) {
+			/* Being interrupted by a signal is not an error, it
+			   just looks like a timeout to the caller. */
+			return (errno == EINTR)? 0: -1;
+		}
+		if (fds.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+			/* The device was unplugged or the handle is bad. */
+			return -1;
+		}
+	}
+
 	bytes_read = read(dev->device_handle, data, length);
 	if (bytes_read < 0 && errno == EAGAIN)
 		bytes_read = 0;
@@ -448,6 +497,17 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 	return bytes_read;
 }
 
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
+}
+
+/* Reports are buffered by the hidraw driver, not by us. */
+unsigned long HID_API_EXPORT hid_get_input_overflow(hid_device *dev)
+{
+	return 0;
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	int flags, res;
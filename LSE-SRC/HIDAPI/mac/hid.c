@@ -111,6 +111,7 @@ struct hid_device_ {
 	uint8_t *input_report_buf;
 	CFIndex max_input_report_len;
 	struct input_report *input_reports;
+	unsigned long input_overflow; /* Reports dropped because the queue was full */
 
 	pthread_t thread;
 	pthread_mutex_t mutex; /* Protects input_reports */
@@ -140,6 +141,7 @@ static hid_device *new_hid_device(void)
 	dev->source = NULL;
 	dev->input_report_buf = NULL;
 	dev->input_reports = NULL;
+	dev->input_overflow = 0;
 	dev->shutdown_thread = 0;
 	dev->next = NULL;
 
@@ -601,6 +603,7 @@ static void hid_report_callback(void *context, IOReturn result, void *sender,
 		   anything from the device. */
 		if (num_queued > 30) {
 			return_data(dev, NULL, 0);
+			dev->input_overflow++;
 		}
 	}
 
@@ -859,6 +862,18 @@ static int cond_timedwait(const hid_device *dev, pthread_cond_t *cond, pthread_m
 
 }
 
+/* This backend has no queued write path; every write completes
+   before returning, so there is never anything left to flush. */
+int HID_API_EXPORT hid_write_async(hid_device *dev, const unsigned char *data, size_t length, int max_pending)
+{
+	return hid_write(dev, data, length);
+}
+
+int HID_API_EXPORT hid_write_flush(hid_device *dev)
+{
+	return 0;
+}
+
 int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
 {
 	int bytes_read = -1;
@@ -938,6 +953,17 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
 	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
+unsigned long HID_API_EXPORT hid_get_input_overflow(hid_device *dev)
+{
+	unsigned long overflow;
+
+	pthread_mutex_lock(&dev->mutex);
+	overflow = dev->input_overflow;
+	pthread_mutex_unlock(&dev->mutex);
+
+	return overflow;
+}
+
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	/* All Nonblocking operation is handled by the library. */
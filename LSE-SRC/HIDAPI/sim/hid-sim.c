@@ -0,0 +1,835 @@
+/*******************************************************
+ HIDAPI - Multi-Platform library for
+ communication with HID devices.
+
+ Simulator Version
+
+ Stands in for one or more PIC18 devices running the
+ Microchip HID bootloader, so the programming path can be
+ exercised and benchmarked without hardware. Every packet
+ is handled in-process against an emulated flash, EEPROM
+ and config bit map.
+
+ The simulation is configured from the environment when
+ hid_init() runs (or on first use):
+
+   HIDSIM_DEVICES        number of bootloaders attached (1)
+   HIDSIM_FLASH_SIZE     end of program memory (0x4000)
+   HIDSIM_LATENCY_US     one-way bus latency per packet (1000)
+   HIDSIM_PROGRAM_US     device time per PROGRAM_DEVICE (500)
+   HIDSIM_ERASE_PAGE_US  device time per erased page (2000)
+   HIDSIM_LOSS           probability an input report is lost (0)
+   HIDSIM_SEED           seed for the loss generator (1)
+   HIDSIM_PAGE_CRC       0 emulates a bootloader without the
+                         GET_PAGE_CRC and ERASE_PAGE commands (1)
+   HIDSIM_STATE_DIR      if set, device memory is loaded from
+                         and saved to <dir>/hidsim<N>.bin so it
+                         survives between processes
+
+ At the discretion of the user of this library,
+ this software may be licensed under the terms of the
+ GNU Public License v3, a BSD-Style license, or the
+ original HIDAPI license as outlined in the LICENSE.txt,
+ LICENSE-gpl3.txt, LICENSE-bsd.txt, and LICENSE-orig.txt
+ files located at the root of the source distribution.
+ These files may also be found in the public source
+ code repository located at:
+        http://github.com/signal11/hidapi .
+********************************************************/
+
+/* C */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <wchar.h>
+
+/* Unix */
+#include <pthread.h>
+
+#include "hidapi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef DEBUG_PRINTF
+#define LOG(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define LOG(...) do {} while (0)
+#endif
+
+#define SIM_VENDOR_ID   0x04d8
+#define SIM_PRODUCT_ID  0x003C
+
+/* Most bootloaders that can be attached at once. */
+#define SIM_MAX_DEVICES 8
+
+/* Input and output reports, without the report ID. */
+#define SIM_REPORT_SIZE 64
+
+/* Number of input reports buffered per device, as in the libusb backend. */
+#define SIM_INPUT_SLOTS 64
+
+/* Upper bound on the window passed to hid_write_async(). */
+#define MAX_PENDING_WRITES 32
+
+/* Bootloader commands (see Comm.h). */
+#define QUERY_DEVICE        0x02
+#define UNLOCK_CONFIG       0x03
+#define ERASE_DEVICE        0x04
+#define PROGRAM_DEVICE      0x05
+#define PROGRAM_COMPLETE    0x06
+#define GET_DATA            0x07
+#define RESET_DEVICE        0x08
+#define SIGN_FLASH          0x09
+#define QUERY_EXTENDED_INFO 0x0C
+#define GET_PAGE_CRC        0x0D
+#define ERASE_PAGE          0x0E
+
+/* Emulated part: a PIC18F14K50 with the bootloader in 0x0000-0x0FFF. The
+   end of program memory can be moved with HIDSIM_FLASH_SIZE. */
+#define SIM_FAMILY_PIC18        0x01
+#define SIM_BYTES_PER_PACKET    56
+#define SIM_FLASH_SIZE          0x4000
+#define SIM_MAX_FLASH_SIZE      0x200000
+#define SIM_APP_START           0x1000
+#define SIM_EEPROM_ADDRESS      0xF00000
+#define SIM_EEPROM_SIZE         0x100
+#define SIM_CONFIG_ADDRESS      0x300000
+#define SIM_CONFIG_SIZE         0x0E
+#define SIM_ERASE_PAGE_SIZE     64
+#define SIM_SIGNATURE_ADDRESS   0x1006
+#define SIM_SIGNATURE_VALUE     0x600D
+#define SIM_BOOTLOADER_VERSION  0x0102
+
+#define SIM_PROGRAM_MEMORY      0x01
+#define SIM_EEPROM_MEMORY       0x02
+#define SIM_CONFIG_MEMORY       0x03
+#define SIM_END_OF_TYPES_LIST   0xFF
+#define SIM_V1_01_OR_NEWER_FLAG 0xA5
+#define SIM_MAX_PAGE_CRCS       29
+
+/* Non-volatile state of one emulated bootloader. It lives for as long as
+   the library is initialised, so it survives hid_close()/hid_open(). */
+struct sim_memory {
+	uint8_t *flash;
+	uint8_t eeprom[SIM_EEPROM_SIZE];
+	uint8_t config[SIM_CONFIG_SIZE];
+};
+
+struct sim_input_report {
+	uint8_t data[SIM_REPORT_SIZE];
+	int64_t ready_us;
+};
+
+struct hid_device_ {
+	int index;
+	struct sim_memory *memory;
+	int config_unlocked;
+	int blocking;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+
+	/* Replies waiting for hid_read(), each with the time it reaches the host. */
+	struct sim_input_report input[SIM_INPUT_SLOTS];
+	unsigned int input_head;
+	unsigned int input_count;
+	unsigned long input_overflow;
+	unsigned long input_lost;
+
+	/* Time at which the emulated device finishes its current command. */
+	int64_t busy_until_us;
+
+	/* Times at which the device takes each hid_write_async() packet off the bus. */
+	int64_t pending[MAX_PENDING_WRITES];
+	unsigned int pending_head;
+	unsigned int pending_count;
+
+	unsigned int seed;
+};
+
+static struct {
+	int initialized;
+	int device_count;
+	uint32_t flash_size;
+	long latency_us;
+	long program_us;
+	long erase_page_us;
+	double loss;
+	unsigned int seed;
+	int page_crc;
+	const char *state_dir;
+	struct sim_memory memory[SIM_MAX_DEVICES];
+	hid_device *open[SIM_MAX_DEVICES];
+} sim;
+
+static pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void to_timespec(int64_t us, struct timespec *ts)
+{
+	ts->tv_sec = us / 1000000;
+	ts->tv_nsec = (us % 1000000) * 1000;
+}
+
+static void sleep_until(int64_t us)
+{
+	int64_t now;
+	struct timespec ts;
+
+	while ((now = now_us()) < us) {
+		to_timespec(us - now, &ts);
+		nanosleep(&ts, NULL);
+	}
+}
+
+static long env_long(const char *name, long def)
+{
+	const char *value = getenv(name);
+	return value ? strtol(value, NULL, 0) : def;
+}
+
+static void state_file_name(int index, char *name, size_t len)
+{
+	snprintf(name, len, "%s/hidsim%d.bin", sim.state_dir, index);
+}
+
+static void load_state(int index)
+{
+	char name[1024];
+	FILE *f;
+
+	if (!sim.state_dir)
+		return;
+	state_file_name(index, name, sizeof(name));
+	f = fopen(name, "rb");
+	if (f) {
+		if (fread(sim.memory[index].flash, sim.flash_size, 1, f) != 1 ||
+		    fread(sim.memory[index].eeprom, SIM_EEPROM_SIZE, 1, f) != 1 ||
+		    fread(sim.memory[index].config, SIM_CONFIG_SIZE, 1, f) != 1)
+			LOG("hidsim: short state file %s\n", name);
+		fclose(f);
+	}
+}
+
+static void save_state(int index)
+{
+	char name[1024];
+	FILE *f;
+
+	if (!sim.state_dir)
+		return;
+	state_file_name(index, name, sizeof(name));
+	f = fopen(name, "wb");
+	if (f) {
+		fwrite(sim.memory[index].flash, sim.flash_size, 1, f);
+		fwrite(sim.memory[index].eeprom, SIM_EEPROM_SIZE, 1, f);
+		fwrite(sim.memory[index].config, SIM_CONFIG_SIZE, 1, f);
+		fclose(f);
+	}
+}
+
+int HID_API_EXPORT hid_init(void)
+{
+	const char *value;
+	int i;
+
+	pthread_mutex_lock(&sim_mutex);
+	if (!sim.initialized) {
+		sim.device_count = env_long("HIDSIM_DEVICES", 1);
+		if (sim.device_count < 0)
+			sim.device_count = 0;
+		if (sim.device_count > SIM_MAX_DEVICES)
+			sim.device_count = SIM_MAX_DEVICES;
+		sim.flash_size = env_long("HIDSIM_FLASH_SIZE", SIM_FLASH_SIZE);
+		if (sim.flash_size < SIM_APP_START + SIM_ERASE_PAGE_SIZE)
+			sim.flash_size = SIM_APP_START + SIM_ERASE_PAGE_SIZE;
+		if (sim.flash_size > SIM_MAX_FLASH_SIZE)
+			sim.flash_size = SIM_MAX_FLASH_SIZE;
+		sim.flash_size -= sim.flash_size % SIM_ERASE_PAGE_SIZE;
+		sim.latency_us = env_long("HIDSIM_LATENCY_US", 1000);
+		sim.program_us = env_long("HIDSIM_PROGRAM_US", 500);
+		sim.erase_page_us = env_long("HIDSIM_ERASE_PAGE_US", 2000);
+		value = getenv("HIDSIM_LOSS");
+		sim.loss = value ? strtod(value, NULL) : 0.0;
+		sim.seed = env_long("HIDSIM_SEED", 1);
+		sim.page_crc = env_long("HIDSIM_PAGE_CRC", 1);
+		sim.state_dir = getenv("HIDSIM_STATE_DIR");
+
+		for (i = 0; i < SIM_MAX_DEVICES; i++) {
+			/* The bootloader itself reads back as zeros, everything else starts blank. */
+			sim.memory[i].flash = (uint8_t*) malloc(sim.flash_size);
+			memset(sim.memory[i].flash, 0xFF, sim.flash_size);
+			memset(sim.memory[i].flash, 0x00, SIM_APP_START);
+			memset(sim.memory[i].eeprom, 0xFF, SIM_EEPROM_SIZE);
+			memset(sim.memory[i].config, 0xFF, SIM_CONFIG_SIZE);
+			sim.open[i] = NULL;
+			load_state(i);
+		}
+		sim.initialized = 1;
+	}
+	pthread_mutex_unlock(&sim_mutex);
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_exit(void)
+{
+	int i;
+
+	pthread_mutex_lock(&sim_mutex);
+	for (i = 0; i < SIM_MAX_DEVICES; i++) {
+		if (sim.open[i]) {
+			/* Still in use. */
+			pthread_mutex_unlock(&sim_mutex);
+			return -1;
+		}
+	}
+	/* The next hid_init() re-reads the environment and starts from blank (or saved) devices. */
+	if (sim.initialized) {
+		for (i = 0; i < SIM_MAX_DEVICES; i++) {
+			free(sim.memory[i].flash);
+			sim.memory[i].flash = NULL;
+		}
+	}
+	sim.initialized = 0;
+	pthread_mutex_unlock(&sim_mutex);
+
+	return 0;
+}
+
+struct hid_device_info  HID_API_EXPORT *hid_enumerate(unsigned short vendor_id, unsigned short product_id)
+{
+	struct hid_device_info *root = NULL;
+	struct hid_device_info *cur_dev = NULL;
+	struct hid_device_info *tmp;
+	char path[32];
+	wchar_t serial[16];
+	int i;
+
+	hid_init();
+
+	if ((vendor_id != 0x0 && vendor_id != SIM_VENDOR_ID) ||
+	    (product_id != 0x0 && product_id != SIM_PRODUCT_ID))
+		return NULL;
+
+	for (i = 0; i < sim.device_count; i++) {
+		tmp = (struct hid_device_info*) calloc(1, sizeof(struct hid_device_info));
+		if (cur_dev)
+			cur_dev->next = tmp;
+		else
+			root = tmp;
+		cur_dev = tmp;
+
+		snprintf(path, sizeof(path), "sim:%d", i);
+		swprintf(serial, sizeof(serial) / sizeof(serial[0]), L"SIM%d", i);
+		cur_dev->path = strdup(path);
+		cur_dev->vendor_id = SIM_VENDOR_ID;
+		cur_dev->product_id = SIM_PRODUCT_ID;
+		cur_dev->serial_number = wcsdup(serial);
+		cur_dev->release_number = SIM_BOOTLOADER_VERSION;
+		cur_dev->manufacturer_string = wcsdup(L"Microchip Technology Inc.");
+		cur_dev->product_string = wcsdup(L"HID Bootloader Simulator");
+		cur_dev->interface_number = 0;
+		cur_dev->next = NULL;
+	}
+
+	return root;
+}
+
+void  HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs)
+{
+	struct hid_device_info *d = devs;
+	while (d) {
+		struct hid_device_info *next = d->next;
+		free(d->path);
+		free(d->serial_number);
+		free(d->manufacturer_string);
+		free(d->product_string);
+		free(d);
+		d = next;
+	}
+}
+
+hid_device * hid_open(unsigned short vendor_id, unsigned short product_id, wchar_t *serial_number)
+{
+	struct hid_device_info *devs, *cur_dev;
+	const char *path_to_open = NULL;
+	hid_device *handle = NULL;
+
+	devs = hid_enumerate(vendor_id, product_id);
+	cur_dev = devs;
+	while (cur_dev) {
+		if (serial_number == NULL || wcscmp(serial_number, cur_dev->serial_number) == 0) {
+			path_to_open = cur_dev->path;
+			break;
+		}
+		cur_dev = cur_dev->next;
+	}
+
+	if (path_to_open) {
+		/* Open the device */
+		handle = hid_open_path(path_to_open);
+	}
+
+	hid_free_enumeration(devs);
+
+	return handle;
+}
+
+hid_device * HID_API_EXPORT hid_open_path(const char *path)
+{
+	hid_device *dev;
+	int index;
+
+	hid_init();
+
+	if (sscanf(path, "sim:%d", &index) != 1 || index < 0 || index >= sim.device_count)
+		return NULL;
+
+	pthread_mutex_lock(&sim_mutex);
+	if (sim.open[index]) {
+		/* Claimed by another handle, as a real interface would be. */
+		pthread_mutex_unlock(&sim_mutex);
+		return NULL;
+	}
+
+	dev = (hid_device*) calloc(1, sizeof(hid_device));
+	dev->index = index;
+	dev->memory = &sim.memory[index];
+	dev->blocking = 1;
+	dev->seed = sim.seed + index;
+	pthread_mutex_init(&dev->mutex, NULL);
+	pthread_cond_init(&dev->condition, NULL);
+	sim.open[index] = dev;
+	pthread_mutex_unlock(&sim_mutex);
+
+	return dev;
+}
+
+static uint32_t get_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le16(unsigned char *p, uint16_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+static void put_le32(unsigned char *p, uint32_t v)
+{
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = (v >> 24) & 0xFF;
+}
+
+static uint8_t read_byte(hid_device *dev, uint32_t address)
+{
+	if (address < sim.flash_size)
+		return dev->memory->flash[address];
+	if (address >= SIM_EEPROM_ADDRESS && address < SIM_EEPROM_ADDRESS + SIM_EEPROM_SIZE)
+		return dev->memory->eeprom[address - SIM_EEPROM_ADDRESS];
+	if (address >= SIM_CONFIG_ADDRESS && address < SIM_CONFIG_ADDRESS + SIM_CONFIG_SIZE)
+		return dev->memory->config[address - SIM_CONFIG_ADDRESS];
+	/* Unimplemented memory reads as zero. */
+	return 0x00;
+}
+
+static void program_byte(hid_device *dev, uint32_t address, uint8_t value)
+{
+	if (address >= SIM_APP_START && address < sim.flash_size) {
+		/* The signature word is only ever written by SIGN_FLASH. */
+		if (address == SIM_SIGNATURE_ADDRESS || address == SIM_SIGNATURE_ADDRESS + 1)
+			return;
+		/* Flash can only clear bits; it needs an erase to set them again. */
+		dev->memory->flash[address] &= value;
+	}
+	else if (address >= SIM_EEPROM_ADDRESS && address < SIM_EEPROM_ADDRESS + SIM_EEPROM_SIZE) {
+		dev->memory->eeprom[address - SIM_EEPROM_ADDRESS] = value;
+	}
+	else if (address >= SIM_CONFIG_ADDRESS && address < SIM_CONFIG_ADDRESS + SIM_CONFIG_SIZE) {
+		if (dev->config_unlocked)
+			dev->memory->config[address - SIM_CONFIG_ADDRESS] = value;
+	}
+	/* Writes anywhere else, including over the bootloader, are ignored. */
+}
+
+/* CRC-16/CCITT (polynomial 0x1021, initial value 0xFFFF) of one erase page. */
+static uint16_t page_crc(hid_device *dev, uint32_t address)
+{
+	uint16_t crc = 0xFFFF;
+	uint32_t i;
+	int bit;
+
+	for (i = 0; i < SIM_ERASE_PAGE_SIZE; i++) {
+		crc ^= (uint16_t)read_byte(dev, address + i) << 8;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+	}
+	return crc;
+}
+
+/* Queues a reply that reaches the host at ready_us. Requires dev->mutex. */
+static void queue_reply(hid_device *dev, const unsigned char *report, int64_t ready_us)
+{
+	struct sim_input_report *slot;
+
+	if (sim.loss > 0.0 && ((double)rand_r(&dev->seed) / RAND_MAX) < sim.loss) {
+		dev->input_lost++;
+		LOG("hidsim: dropping reply to command 0x%02x\n", report[0]);
+		return;
+	}
+
+	if (dev->input_count == SIM_INPUT_SLOTS) {
+		dev->input_overflow++;
+		return;
+	}
+
+	slot = &dev->input[(dev->input_head + dev->input_count) % SIM_INPUT_SLOTS];
+	memcpy(slot->data, report, SIM_REPORT_SIZE);
+	slot->ready_us = ready_us;
+	dev->input_count++;
+	pthread_cond_broadcast(&dev->condition);
+}
+
+/* Runs one output report through the emulated bootloader. Returns the time the
+   device takes the packet off the bus. Requires dev->mutex. */
+static int64_t device_accept(hid_device *dev, const unsigned char *data, size_t length)
+{
+	unsigned char reply[SIM_REPORT_SIZE];
+	const unsigned char *packet;
+	int64_t start, service = 0;
+	uint32_t address, i;
+	unsigned int n;
+
+	start = now_us() + sim.latency_us;
+	if (start < dev->busy_until_us)
+		start = dev->busy_until_us;
+
+	/* data[0] is the report ID. */
+	if (length < 8)
+		return start;
+	packet = data + 1;
+	address = get_le32(packet + 1);
+	n = packet[5];
+	if (n > 58)
+		n = 58;
+
+	memset(reply, 0x00, sizeof(reply));
+
+	switch (packet[0]) {
+	case QUERY_DEVICE:
+		reply[0] = QUERY_DEVICE;
+		reply[1] = SIM_BYTES_PER_PACKET;
+		reply[2] = SIM_FAMILY_PIC18;
+		reply[3] = SIM_PROGRAM_MEMORY;
+		put_le32(reply + 4, SIM_APP_START);
+		put_le32(reply + 8, sim.flash_size - SIM_APP_START);
+		reply[12] = SIM_EEPROM_MEMORY;
+		put_le32(reply + 13, SIM_EEPROM_ADDRESS);
+		put_le32(reply + 17, SIM_EEPROM_SIZE);
+		reply[21] = SIM_CONFIG_MEMORY;
+		put_le32(reply + 22, SIM_CONFIG_ADDRESS);
+		put_le32(reply + 26, SIM_CONFIG_SIZE);
+		reply[30] = SIM_END_OF_TYPES_LIST;
+		reply[57] = SIM_V1_01_OR_NEWER_FLAG;
+		queue_reply(dev, reply, start + sim.latency_us);
+		break;
+
+	case QUERY_EXTENDED_INFO:
+		reply[0] = QUERY_EXTENDED_INFO;
+		put_le16(reply + 1, SIM_BOOTLOADER_VERSION);
+		put_le16(reply + 3, 0x0000);
+		put_le32(reply + 5, SIM_SIGNATURE_ADDRESS);
+		put_le16(reply + 9, SIM_SIGNATURE_VALUE);
+		put_le32(reply + 11, SIM_ERASE_PAGE_SIZE);
+		memset(reply + 15, 0xFF, 14);
+		queue_reply(dev, reply, start + sim.latency_us);
+		break;
+
+	case UNLOCK_CONFIG:
+		dev->config_unlocked = (packet[1] == 0x00);
+		break;
+
+	case ERASE_DEVICE:
+		memset(dev->memory->flash + SIM_APP_START, 0xFF, sim.flash_size - SIM_APP_START);
+		service = (int64_t)sim.erase_page_us * ((sim.flash_size - SIM_APP_START) / SIM_ERASE_PAGE_SIZE);
+		break;
+
+	case ERASE_PAGE:
+		if (!sim.page_crc) {
+			LOG("hidsim: ignoring command 0x%02x\n", packet[0]);
+			break;
+		}
+		/* Erases the one page containing address; the bootloader itself is protected. */
+		address -= address % SIM_ERASE_PAGE_SIZE;
+		if (address >= SIM_APP_START && address < sim.flash_size) {
+			memset(dev->memory->flash + address, 0xFF, SIM_ERASE_PAGE_SIZE);
+			service = sim.erase_page_us;
+		}
+		break;
+
+	case PROGRAM_DEVICE:
+		/* The payload is right justified in the 58 byte data field. */
+		for (i = 0; i < n; i++)
+			program_byte(dev, address + i, packet[6 + 58 - n + i]);
+		service = sim.program_us;
+		break;
+
+	case PROGRAM_COMPLETE:
+		/* Nothing is buffered, so there is nothing to flush. */
+		break;
+
+	case GET_DATA:
+		reply[0] = GET_DATA;
+		put_le32(reply + 1, address);
+		reply[5] = n;
+		for (i = 0; i < n; i++)
+			reply[6 + 58 - n + i] = read_byte(dev, address + i);
+		queue_reply(dev, reply, start + sim.latency_us);
+		break;
+
+	case GET_PAGE_CRC:
+		if (!sim.page_crc) {
+			LOG("hidsim: ignoring command 0x%02x\n", packet[0]);
+			break;
+		}
+		/* The CRCs of n consecutive erase pages, little endian from data[0] on. */
+		if (n > SIM_MAX_PAGE_CRCS)
+			n = SIM_MAX_PAGE_CRCS;
+		reply[0] = GET_PAGE_CRC;
+		put_le32(reply + 1, address);
+		reply[5] = n;
+		for (i = 0; i < n; i++)
+			put_le16(reply + 6 + 2 * i, page_crc(dev, address + i * SIM_ERASE_PAGE_SIZE));
+		queue_reply(dev, reply, start + sim.latency_us);
+		break;
+
+	case SIGN_FLASH:
+		dev->memory->flash[SIM_SIGNATURE_ADDRESS] &= SIM_SIGNATURE_VALUE & 0xFF;
+		dev->memory->flash[SIM_SIGNATURE_ADDRESS + 1] &= SIM_SIGNATURE_VALUE >> 8;
+		service = sim.erase_page_us;
+		break;
+
+	case RESET_DEVICE:
+		/* Forget everything volatile; the host has to re-open after a real reset. */
+		dev->config_unlocked = 0;
+		dev->input_head = 0;
+		dev->input_count = 0;
+		break;
+
+	default:
+		/* The firmware ignores commands it does not know. */
+		LOG("hidsim: ignoring command 0x%02x\n", packet[0]);
+		break;
+	}
+
+	dev->busy_until_us = start + service;
+	return start;
+}
+
+int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length)
+{
+	int64_t accepted;
+
+	pthread_mutex_lock(&dev->mutex);
+	accepted = device_accept(dev, data, length);
+	pthread_mutex_unlock(&dev->mutex);
+
+	/* A blocking interrupt OUT transfer completes once the device has taken it. */
+	sleep_until(accepted);
+
+	return length;
+}
+
+int HID_API_EXPORT hid_write_async(hid_device *dev, const unsigned char *data, size_t length, int max_pending)
+{
+	int64_t now, oldest;
+
+	if (max_pending < 1)
+		max_pending = 1;
+	if (max_pending > MAX_PENDING_WRITES)
+		max_pending = MAX_PENDING_WRITES;
+
+	pthread_mutex_lock(&dev->mutex);
+
+	/* Wait for room in the window. */
+	for (;;) {
+		now = now_us();
+		while (dev->pending_count > 0 && dev->pending[dev->pending_head] <= now) {
+			dev->pending_head = (dev->pending_head + 1) % MAX_PENDING_WRITES;
+			dev->pending_count--;
+		}
+		if (dev->pending_count < (unsigned int)max_pending)
+			break;
+		oldest = dev->pending[dev->pending_head];
+		pthread_mutex_unlock(&dev->mutex);
+		sleep_until(oldest);
+		pthread_mutex_lock(&dev->mutex);
+	}
+
+	dev->pending[(dev->pending_head + dev->pending_count) % MAX_PENDING_WRITES] = device_accept(dev, data, length);
+	dev->pending_count++;
+
+	pthread_mutex_unlock(&dev->mutex);
+
+	return length;
+}
+
+int HID_API_EXPORT hid_write_flush(hid_device *dev)
+{
+	int64_t last = 0;
+
+	pthread_mutex_lock(&dev->mutex);
+	if (dev->pending_count > 0)
+		last = dev->pending[(dev->pending_head + dev->pending_count - 1) % MAX_PENDING_WRITES];
+	dev->pending_head = 0;
+	dev->pending_count = 0;
+	pthread_mutex_unlock(&dev->mutex);
+
+	sleep_until(last);
+
+	return 0;
+}
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	struct sim_input_report *slot;
+	struct timespec ts;
+	int64_t now, deadline, wake;
+	int bytes_read = 0;
+
+	deadline = (milliseconds >= 0) ? now_us() + (int64_t)milliseconds * 1000 : -1;
+
+	pthread_mutex_lock(&dev->mutex);
+	for (;;) {
+		now = now_us();
+		if (dev->input_count > 0 && dev->input[dev->input_head].ready_us <= now) {
+			slot = &dev->input[dev->input_head];
+			bytes_read = (length < SIM_REPORT_SIZE) ? length : SIM_REPORT_SIZE;
+			memcpy(data, slot->data, bytes_read);
+			dev->input_head = (dev->input_head + 1) % SIM_INPUT_SLOTS;
+			dev->input_count--;
+			break;
+		}
+		if (deadline >= 0 && now >= deadline)
+			break;
+
+		/* Sleep until the next reply arrives on the bus, a new one is queued, or the timeout. */
+		wake = deadline;
+		if (dev->input_count > 0 && (wake < 0 || dev->input[dev->input_head].ready_us < wake))
+			wake = dev->input[dev->input_head].ready_us;
+		if (wake < 0) {
+			pthread_cond_wait(&dev->condition, &dev->mutex);
+		}
+		else {
+			to_timespec(wake, &ts);
+			pthread_cond_timedwait(&dev->condition, &dev->mutex, &ts);
+		}
+	}
+	pthread_mutex_unlock(&dev->mutex);
+
+	return bytes_read;
+}
+
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, dev->blocking ? -1 : 0);
+}
+
+unsigned long HID_API_EXPORT hid_get_input_overflow(hid_device *dev)
+{
+	return dev->input_overflow;
+}
+
+int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock)
+{
+	dev->blocking = !nonblock;
+	return 0;
+}
+
+int HID_API_EXPORT hid_send_feature_report(hid_device *dev, const unsigned char *data, size_t length)
+{
+	/* The bootloader has no feature reports. */
+	return -1;
+}
+
+int HID_API_EXPORT hid_get_feature_report(hid_device *dev, unsigned char *data, size_t length)
+{
+	return -1;
+}
+
+void HID_API_EXPORT hid_close(hid_device *dev)
+{
+	if (!dev)
+		return;
+
+	/* Let queued packets reach the device before it goes away. */
+	hid_write_flush(dev);
+
+	pthread_mutex_lock(&sim_mutex);
+	save_state(dev->index);
+	sim.open[dev->index] = NULL;
+	pthread_mutex_unlock(&sim_mutex);
+
+	if (dev->input_lost)
+		LOG("hidsim: sim:%d lost %lu input reports\n", dev->index, dev->input_lost);
+
+	pthread_mutex_destroy(&dev->mutex);
+	pthread_cond_destroy(&dev->condition);
+	free(dev);
+}
+
+static int copy_string(const wchar_t *src, wchar_t *string, size_t maxlen)
+{
+	if (maxlen == 0)
+		return -1;
+	wcsncpy(string, src, maxlen);
+	string[maxlen - 1] = L'\0';
+	return 0;
+}
+
+int HID_API_EXPORT_CALL hid_get_manufacturer_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	return copy_string(L"Microchip Technology Inc.", string, maxlen);
+}
+
+int HID_API_EXPORT_CALL hid_get_product_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	return copy_string(L"HID Bootloader Simulator", string, maxlen);
+}
+
+int HID_API_EXPORT_CALL hid_get_serial_number_string(hid_device *dev, wchar_t *string, size_t maxlen)
+{
+	wchar_t serial[16];
+
+	swprintf(serial, sizeof(serial) / sizeof(serial[0]), L"SIM%d", dev->index);
+	return copy_string(serial, string, maxlen);
+}
+
+int HID_API_EXPORT_CALL hid_get_indexed_string(hid_device *dev, int string_index, wchar_t *string, size_t maxlen)
+{
+	return -1;
+}
+
+HID_API_EXPORT const wchar_t * HID_API_CALL  hid_error(hid_device *dev)
+{
+	return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -53,6 +53,10 @@ extern "C" {
 
 #include "../hidapi.h"
 
+// How long a blocking hid_write() waits for the device to take a report,
+// the same as the interrupt transfer timeout of the libusb backend.
+#define WRITE_TIMEOUT_MS 1000
+
 #ifdef _MSC_VER
 	// Thanks Microsoft, but I know how to use strncpy().
 	#pragma warning(disable:4996)
@@ -117,6 +121,12 @@ struct hid_device_ {
 		void *last_error_str;
                 DWORD last_error_num;
                 BOOL ioPending;
+		// Per device, so writes to several devices from different
+		// threads never share an OVERLAPPED the kernel may still own.
+		OVERLAPPED write_ol;
+		OVERLAPPED read_ol;
+		BOOL read_pending;
+		unsigned char *read_buf;
 };
 
 static hid_device *new_hid_device()
@@ -128,6 +138,12 @@ static hid_device *new_hid_device()
 	dev->last_error_str = NULL;
         dev->last_error_num = 0;
         dev->ioPending = false;
+	memset(&dev->write_ol, 0, sizeof(dev->write_ol));
+	dev->write_ol.hEvent = CreateEvent(NULL, TRUE, FALSE /*inital state f=nonsignaled*/, NULL);
+	memset(&dev->read_ol, 0, sizeof(dev->read_ol));
+	dev->read_ol.hEvent = CreateEvent(NULL, TRUE, FALSE /*inital state f=nonsignaled*/, NULL);
+	dev->read_pending = FALSE;
+	dev->read_buf = NULL;
 
 	return dev;
 }
@@ -186,6 +202,18 @@ static void lookup_functions()
 }
 #endif
 
+// The Windows backend keeps no library-wide state, so there is nothing
+// to set up or tear down.
+int HID_API_EXPORT HID_API_CALL hid_init(void)
+{
+	return 0;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_exit(void)
+{
+	return 0;
+}
+
 struct hid_device_info HID_API_EXPORT * HID_API_CALL hid_enumerate(unsigned short vendor_id, unsigned short product_id)
 {
 	BOOL res;
@@ -458,12 +486,20 @@ HID_API_EXPORT hid_device * HID_API_CALL hid_open_path(const char *path)
 	dev->input_report_length = caps.InputReportByteLength;
 	HidD_FreePreparsedData(pp_data);
 
+	// Overlapped reads land in this buffer, so a read that times out
+	// can stay queued without writing into the caller's memory later.
+	dev->read_buf = (unsigned char*) malloc(dev->input_report_length);
+	if (dev->read_buf == NULL)
+		goto err;
+
 	return dev;
 
 err_pp_data:
 		HidD_FreePreparsedData(pp_data);
 err:	
 		CloseHandle(dev->device_handle);
+		CloseHandle(dev->write_ol.hEvent);
+		CloseHandle(dev->read_ol.hEvent);
 		free(dev);
 		return NULL;
 }
@@ -471,14 +507,14 @@ err:
 int HID_API_EXPORT HID_API_CALL hid_write(hid_device *dev, const unsigned char *data, size_t length)
 {
         DWORD bytes_written;
+        DWORD bytes_read;
         BOOL res;
-
-        static OVERLAPPED ol;
+        HANDLE event;
 
 Check_For_Result:
         if(!dev->blocking && dev->ioPending)
         {
-            res = GetOverlappedResult(dev->device_handle, &ol, &bytes_written, FALSE/*don't wait*/);
+            res = GetOverlappedResult(dev->device_handle, &dev->write_ol, &bytes_written, FALSE/*don't wait*/);
             if(!res)
             {
                 return 0;
@@ -490,9 +526,12 @@ Check_For_Result:
             }
         }
 
-        memset(&ol, 0, sizeof(ol));
+        event = dev->write_ol.hEvent;
+        memset(&dev->write_ol, 0, sizeof(dev->write_ol));
+        dev->write_ol.hEvent = event;
+        ResetEvent(event);
 
-        res = WriteFile(dev->device_handle, data, length, &bytes_written, &ol);
+        res = WriteFile(dev->device_handle, data, length, &bytes_written, &dev->write_ol);
 
         if (!res) {
             if (GetLastError() != ERROR_IO_PENDING) {
@@ -510,8 +549,24 @@ Check_For_Result:
         else
         {
             // Wait here until the write is done. This makes
-            // hid_write() synchronous.
-            res = GetOverlappedResult(dev->device_handle, &ol, &bytes_written, TRUE/*wait*/);
+            // hid_write() synchronous, but a device that stops taking
+            // reports must not hang the caller, so give up after
+            // WRITE_TIMEOUT_MS and return 0 (nothing written) to let the
+            // caller retry or time out.
+            if (WaitForSingleObject(dev->write_ol.hEvent, WRITE_TIMEOUT_MS) != WAIT_OBJECT_0) {
+                CancelIo(dev->device_handle);
+                res = GetOverlappedResult(dev->device_handle, &dev->write_ol, &bytes_written, TRUE/*wait*/);
+
+                // CancelIo() also cancelled a read hid_read_timeout() left
+                // queued. Start a new one next time, unless a report had
+                // already arrived.
+                if (dev->read_pending &&
+                    !GetOverlappedResult(dev->device_handle, &dev->read_ol, &bytes_read, TRUE/*wait*/)) {
+                    dev->read_pending = FALSE;
+                }
+                return res ? (int)bytes_written : 0;
+            }
+            res = GetOverlappedResult(dev->device_handle, &dev->write_ol, &bytes_written, TRUE/*wait*/);
             if (!res) {
                     // The Write operation failed.
                     register_error(dev, "WriteFile");
@@ -523,70 +578,91 @@ Check_For_Result:
 }
 
 
-int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
+/* This backend has no queued write path; every write completes
+   before returning, so there is never anything left to flush. */
+int HID_API_EXPORT HID_API_CALL hid_write_async(hid_device *dev, const unsigned char *data, size_t length, int max_pending)
 {
-    DWORD bytes_read;
-    BOOL res;
+	int res = hid_write(dev, data, length);
 
-    static OVERLAPPED ol;
+	// There is no later call to report a timed out write from, so it is
+	// an error here.
+	if (res == 0) {
+		register_error(dev, "WriteFile");
+		return -1;
+	}
+	return res;
+}
 
-Check_For_Result:
-    if(!dev->blocking && dev->ioPending)
-    {
-        res = GetOverlappedResult(dev->device_handle, &ol, &bytes_read, FALSE/*don't wait*/);
-        if(!res)
-        {
-            return 0;
-        }
-        else
-        {
-            dev->ioPending = false;
-            if (bytes_read > 0 && data[0] == 0x0) {
-                /* If report numbers aren't being used, but Windows sticks a report
-                   number (0x0) on the beginning of the report anyway. To make this
-                   work like the other platforms, and to make it work more like the
-                   HID spec, we'll skip over this byte. */
-                bytes_read--;
-                memmove(data, data+1, bytes_read);
-            }
-            return bytes_read;
-        }
-    }
+int HID_API_EXPORT HID_API_CALL hid_write_flush(hid_device *dev)
+{
+	return 0;
+}
 
-    memset(&ol, 0, sizeof(ol));
+int HID_API_EXPORT HID_API_CALL hid_read_timeout(hid_device *dev, unsigned char *data, size_t length, int milliseconds)
+{
+	DWORD bytes_read = 0;
+	DWORD wait_res;
+	BOOL res;
 
-    // Limit the data to be returned. This ensures we get
-    // only one report returned per call to hid_read().
-    length = (length < dev->input_report_length)? length: dev->input_report_length;
+	// Start a new overlapped read, unless the one queued by an earlier
+	// call that timed out is still outstanding.
+	if (!dev->read_pending) {
+		dev->read_pending = TRUE;
+		ResetEvent(dev->read_ol.hEvent);
+		res = ReadFile(dev->device_handle, dev->read_buf, dev->input_report_length, &bytes_read, &dev->read_ol);
+		if (!res) {
+			if (GetLastError() != ERROR_IO_PENDING) {
+				// ReadFile() failed. Return error.
+				dev->read_pending = FALSE;
+				register_error(dev, "ReadFile");
+				return -1;
+			}
+		}
+	}
 
-    res = ReadFile(dev->device_handle, data, length, &bytes_read, &ol);
+	if (milliseconds >= 0) {
+		// Sleep until the report arrives or the timeout expires.
+		wait_res = WaitForSingleObject(dev->read_ol.hEvent, milliseconds);
+		if (wait_res != WAIT_OBJECT_0) {
+			// There was no data this time. The read stays queued
+			// and is picked up by the next call.
+			return 0;
+		}
+	}
 
-    if (!res) {
-        if (GetLastError() != ERROR_IO_PENDING) {
-            // ReadFile() failed. Return error.
-            register_error(dev, "ReadFile");
-            return -1;
-        }
-    }
-
-    if(!dev->blocking)
-    {
-        dev->ioPending = true;
-        goto Check_For_Result;
-    }
-    else
-    {
-        // Wait here until the write is done. This makes
-        // hid_write() synchronous.
-        res = GetOverlappedResult(dev->device_handle, &ol, &bytes_read, TRUE/*wait*/);
-        if (!res) {
-            // The Read operation failed.
-            register_error(dev, "ReadFile");
-            return -1;
-        }
-    }
+	// The event is signaled (or we were asked to block), so this
+	// either returns straight away or waits for the report.
+	res = GetOverlappedResult(dev->device_handle, &dev->read_ol, &bytes_read, TRUE/*wait*/);
+	dev->read_pending = FALSE;
+	if (!res) {
+		// The Read operation failed.
+		register_error(dev, "ReadFile");
+		return -1;
+	}
+
+	if (bytes_read > 0) {
+		unsigned char *report = dev->read_buf;
+		if (report[0] == 0x0) {
+			/* If report numbers aren't being used, but Windows sticks a report
+			   number (0x0) on the beginning of the report anyway. To make this
+			   work like the other platforms, and to make it work more like the
+			   HID spec, we'll skip over this byte. */
+			report++;
+			bytes_read--;
+		}
+		// Limit the data to be returned. This ensures we get
+		// only one report returned per call to hid_read().
+		if (bytes_read > length)
+			bytes_read = length;
+		memcpy(data, report, bytes_read);
+	}
 
-    return bytes_read;
+	return bytes_read;
+}
+
+int HID_API_EXPORT HID_API_CALL hid_read(hid_device *dev, unsigned char *data, size_t length)
+{
+	return hid_read_timeout(dev, data, length, (dev->blocking)? -1: 0);
 }
 
 void HID_API_EXPORT HID_API_CALL hid_cancelIo(hid_device *dev)
@@ -594,6 +670,12 @@ void HID_API_EXPORT HID_API_CALL hid_cancelIo(hid_device *dev)
     CancelIo(dev->device_handle);
 }
 
+// Reports are buffered by the HID class driver, not by us.
+unsigned long HID_API_EXPORT HID_API_CALL hid_get_input_overflow(hid_device *dev)
+{
+	return 0;
+}
+
 int HID_API_EXPORT HID_API_CALL hid_set_nonblocking(hid_device *dev, int nonblock)
 {
 	dev->blocking = !nonblock;
@@ -658,8 +740,21 @@ void HID_API_EXPORT HID_API_CALL hid_close(hid_device *dev)
 {
 	if (!dev)
 		return;
+	if (dev->read_pending || dev->ioPending) {
+		// Make sure the driver is done with read_buf and the OVERLAPPEDs
+		// before freeing them.
+		DWORD bytes;
+		CancelIo(dev->device_handle);
+		if (dev->read_pending)
+			GetOverlappedResult(dev->device_handle, &dev->read_ol, &bytes, TRUE/*wait*/);
+		if (dev->ioPending)
+			GetOverlappedResult(dev->device_handle, &dev->write_ol, &bytes, TRUE/*wait*/);
+	}
+	CloseHandle(dev->write_ol.hEvent);
+	CloseHandle(dev->read_ol.hEvent);
 	CloseHandle(dev->device_handle);
 	LocalFree(dev->last_error_str);
+	free(dev->read_buf);
 	free(dev);
 }
 
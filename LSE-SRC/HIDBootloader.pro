@@ -3,4 +3,18 @@ CONFIG   += ordered
 
 SUBDIRS = \
     HIDAPI \
-    Bootloader
+    Bootloader \
+    cli \
+    tests
+
+cli.file = Bootloader/LSECli.pro
+tests.file = Bootloader/LSETests.pro
+
+# The benchmark and the end to end tests drive the
+# bootloader simulator, so they are only built with
+# "qmake CONFIG+=hidsim"
+hidsim {
+    SUBDIRS += bench simtests
+    bench.file = Bootloader/LSEBench.pro
+    simtests.file = Bootloader/LSESimTests.pro
+}